@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include <boost/optional.hpp>
+#include "Async.h"
+#include "AsyncCreatureAI.h"
+#include "Await.h"
+#include "FiberPool.h"
+#include "Future.h"
+#include "Scheduler.h"
+#include "TimerWheel.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace Trinity;
+
+/// The simulated duration of a single world update
+static constexpr std::chrono::milliseconds TickDuration = 50ms;
+
+/// Runs a combat script in the style of test/ai, where spells take
+/// a simulated cast time and damage is dealt by the simulator.
+class SimulatedAI : public AsyncCreatureAI
+{
+    std::minstd_rand generator_;
+    boost::optional<Promise<std::uint32_t>> damage_;
+    std::uint32_t health_ = 100000;
+
+  public:
+    SimulatedAI(TimerWheel& timers, std::uint32_t seed)
+        : AsyncCreatureAI(timers), generator_(seed)
+    {
+    }
+
+    void Reset() override
+    {
+        await OnEnterCombat();
+
+        // Reacts to damage next to the combat rotation
+        auto defense = Trinity::Async([this] {
+            while (auto damage = await NextDamage())
+            {
+                health_ -= std::min(health_, damage);
+                if (health_ < 20000)
+                {
+                    await Cast(48782, 1500ms);
+                    health_ = 100000;
+                }
+            }
+        });
+
+        for (;;)
+        {
+            if (generator_() % 2)
+            {
+                await Wait(1s, 3s);
+                await Cast(28373, 2000ms);
+            }
+            else
+            {
+                await Wait(800ms, 1300ms);
+                while ((await Cast(3746, 500ms)) != SpellCastResult::Ok)
+                    ;
+            }
+        }
+    }
+
+    /// Deals the given damage to the script when it waits for damage
+    void Hit(std::uint32_t damage)
+    {
+        if (damage_)
+        {
+            Promise<std::uint32_t> promise = std::move(*damage_);
+            damage_ = boost::none;
+            promise.Resolve(damage);
+        }
+    }
+
+  private:
+    Future<std::uint32_t> NextDamage()
+    {
+        Future<std::uint32_t> future;
+        damage_.emplace(future.GetPromise());
+        return future;
+    }
+
+    /// Casts a spell which fails randomly after the given cast time
+    Future<SpellCastResult> Cast(unsigned spell, std::chrono::milliseconds time)
+    {
+        await Wait(time);
+        await CastSpell(spell);
+        return MakeReadyFuture((generator_() % 8) ? SpellCastResult::Ok
+                                                  : SpellCastResult::Failed);
+    }
+};
+
+/// Returns the resident memory of the process in bytes
+static std::size_t ResidentMemory()
+{
+#ifdef __linux__
+    if (std::FILE* file = std::fopen("/proc/self/statm", "r"))
+    {
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        int const read = std::fscanf(file, "%lu %lu", &size, &resident);
+        std::fclose(file);
+        if (read == 2)
+        {
+            return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        }
+    }
+#endif
+    return 0;
+}
+
+static double Percentile(std::vector<double>& values, double fraction)
+{
+    auto const nth = values.begin() +
+                     static_cast<std::ptrdiff_t>(
+                         fraction * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+/// Simulates the given count of creature scripts, usage:
+/// bench-ai [creatures] [ticks] [small|medium|large]
+int main(int argc, char** argv)
+{
+    std::size_t const creatures =
+        (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    std::size_t const ticks =
+        (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 1000;
+    StackClass stack_class = StackClass::Medium;
+    if (argc > 3)
+    {
+        stack_class = (argv[3][0] == 's')
+                          ? StackClass::Small
+                          : ((argv[3][0] == 'l') ? StackClass::Large
+                                                 : StackClass::Medium);
+    }
+
+    if ((creatures == 0) || (ticks == 0))
+    {
+        std::fprintf(stderr,
+                     "Usage: %s [creatures] [ticks] [small|medium|large]\n",
+                     argv[0]);
+        return 1;
+    }
+
+    TimerWheel wheel;
+    Scheduler scheduler;
+    FiberPool pool;
+    std::minstd_rand generator;
+
+    std::size_t const memory_before = ResidentMemory();
+
+    std::vector<std::unique_ptr<SimulatedAI>> scripts;
+    std::vector<FiberPtr> fibers;
+    scripts.reserve(creatures);
+    fibers.reserve(creatures);
+    for (std::size_t i = 0; i < creatures; ++i)
+    {
+        scripts.push_back(std::make_unique<SimulatedAI>(
+            wheel, static_cast<std::uint32_t>(i + 1)));
+
+        SimulatedAI* const script = scripts.back().get();
+        fibers.push_back(
+            pool.Spawn(stack_class, [script] { script->Reset(); }));
+        fibers.back()->Resume();
+    }
+
+    std::size_t const memory_after = ResidentMemory();
+
+    // Every tick around 5% of the creatures receive damage
+    std::size_t const hits = std::max(creatures / 20, std::size_t(1));
+
+    std::vector<double> latencies;
+    latencies.reserve(ticks);
+    std::size_t resumed = 0;
+
+    auto const begin = std::chrono::steady_clock::now();
+    for (std::size_t tick = 1; tick <= ticks; ++tick)
+    {
+        auto const tick_begin = std::chrono::steady_clock::now();
+
+        wheel.Advance(TimerWheel::TimePoint(TickDuration * tick));
+        for (std::size_t i = 0; i < hits; ++i)
+        {
+            scripts[generator() % creatures]->Hit(500 + generator() % 5000);
+        }
+        resumed += scheduler.Run();
+
+        latencies.push_back(std::chrono::duration<double, std::micro>(
+                                std::chrono::steady_clock::now() - tick_begin)
+                                .count());
+    }
+    std::chrono::duration<double> const elapsed =
+        std::chrono::steady_clock::now() - begin;
+
+    std::printf("creatures:                %zu\n", creatures);
+    std::printf("ticks:                    %zu (%lld ms simulated)\n", ticks,
+                static_cast<long long>((TickDuration * ticks).count()));
+    std::printf("ticks per second:         %.1f\n",
+                static_cast<double>(ticks) / elapsed.count());
+    std::printf("tick latency p50:         %.1f us\n",
+                Percentile(latencies, 0.5));
+    std::printf("tick latency p99:         %.1f us\n",
+                Percentile(latencies, 0.99));
+    std::printf("resident memory/script:  %.0f bytes\n",
+                static_cast<double>(memory_after - memory_before) /
+                    static_cast<double>(creatures));
+    // Every resume switches into the Fiber and back out of it
+    std::printf("context switches/tick:    %.1f\n",
+                2. * static_cast<double>(resumed) /
+                    static_cast<double>(ticks));
+    std::printf("live fibers:              %zu\n", pool.Size());
+
+    // Cancel the scripts before the state they are waiting on is destroyed
+    fibers.clear();
+    return 0;
+}
@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <boost/optional.hpp>
+#include "Async.h"
+#include "Await.h"
+#include "Channel.h"
+#include "Event.h"
+#include "Fiber.h"
+#include "FiberMutex.h"
+#include "FiberPool.h"
+#include "FiberScope.h"
+#include "Future.h"
+#include "RemoteFuture.h"
+#include "Scheduler.h"
+#include "TaskQueue.h"
+
+using namespace Trinity;
+
+#if defined(__GNUC__) && !defined(__clang__)
+// The replaced operators are inlined into new expressions,
+// which GCC mistakes as mismatching allocation functions.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+/// The count of heap allocations of the whole process
+static std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* const memory = std::malloc(size ? size : 1))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+/// Reports the heap allocations per iteration, counted from the
+/// given count of allocations that was observed before the iterations.
+static void ReportAllocations(benchmark::State& state, std::size_t begin)
+{
+    state.counters["allocs/op"] = benchmark::Counter(
+        double(allocations.load(std::memory_order_relaxed) - begin),
+        benchmark::Counter::kAvgIterations);
+}
+
+/// Runs the benchmark loop inside a Fiber, which is required by await
+template <typename Callable>
+static void RunOnFiber(FiberPool& pool, Callable&& callable)
+{
+    FiberPtr fiber =
+        pool.Spawn(StackClass::Large, std::forward<Callable>(callable));
+    fiber->Resume();
+    assert(fiber->Is(Fiber::State::Finished));
+}
+
+static void BM_SpawnRecycle(benchmark::State& state)
+{
+    FiberPool pool;
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        FiberPtr fiber = pool.Spawn([] {});
+        benchmark::DoNotOptimize(fiber.Get());
+    }
+    ReportAllocations(state, begin);
+}
+BENCHMARK(BM_SpawnRecycle);
+
+static void BM_SpawnResumeRecycle(benchmark::State& state)
+{
+    FiberPool pool;
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        pool.Spawn([] {})->Resume();
+    }
+    ReportAllocations(state, begin);
+}
+BENCHMARK(BM_SpawnResumeRecycle);
+
+static void BM_ResumeSuspend(benchmark::State& state)
+{
+    FiberPool pool;
+    FiberPtr fiber = pool.Spawn([] {
+        for (;;)
+        {
+            ThisFiber()->Suspend();
+        }
+    });
+
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        fiber->Resume();
+    }
+    ReportAllocations(state, begin);
+}
+BENCHMARK(BM_ResumeSuspend);
+
+static void BM_AwaitReady(benchmark::State& state)
+{
+    FiberPool pool;
+    RunOnFiber(pool, [&] {
+        auto const begin = allocations.load();
+        for (auto _ : state)
+        {
+            int const value = await MakeReadyFuture(1);
+            benchmark::DoNotOptimize(value);
+        }
+        ReportAllocations(state, begin);
+    });
+}
+BENCHMARK(BM_AwaitReady);
+
+static void BM_AwaitUnready(benchmark::State& state)
+{
+    FiberPool pool;
+    boost::optional<Promise<int>> promise;
+    FiberPtr fiber = pool.Spawn([&] {
+        for (;;)
+        {
+            Future<int> future;
+            promise.emplace(future.GetPromise());
+            int const value = await std::move(future);
+            benchmark::DoNotOptimize(value);
+        }
+    });
+    fiber->Resume();
+
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        // Resolving the Promise continues the waiting Fiber inline,
+        // which suspends on the next Future afterwards.
+        Promise<int> current = std::move(*promise);
+        promise = boost::none;
+        current.Resolve(1);
+    }
+    ReportAllocations(state, begin);
+
+    // The pending Future is dropped when the Fiber is canceled,
+    // which disconnects the Promise before it is destroyed.
+    fiber = nullptr;
+    promise = boost::none;
+}
+BENCHMARK(BM_AwaitUnready);
+
+static void BM_AsyncFromFiber(benchmark::State& state)
+{
+    FiberPool pool;
+    RunOnFiber(pool, [&] {
+        auto const begin = allocations.load();
+        for (auto _ : state)
+        {
+            int const value = await Async([] { return 1; });
+            benchmark::DoNotOptimize(value);
+        }
+        ReportAllocations(state, begin);
+    });
+}
+BENCHMARK(BM_AsyncFromFiber);
+
+static void BM_AsyncLaunchInline(benchmark::State& state)
+{
+    FiberPool pool;
+    RunOnFiber(pool, [&] {
+        auto const begin = allocations.load();
+        for (auto _ : state)
+        {
+            int const value = await Async(Launch::Inline, [] { return 1; });
+            benchmark::DoNotOptimize(value);
+        }
+        ReportAllocations(state, begin);
+    });
+}
+BENCHMARK(BM_AsyncLaunchInline);
+
+static void BM_ThenChain(benchmark::State& state)
+{
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        Future<int> future;
+        auto promise = future.GetPromise();
+        auto doubled = future.Then([](int value) { return value * 2; });
+        auto result = doubled.Then([](int value) { return value + 1; });
+        promise.Resolve(1);
+        benchmark::DoNotOptimize(result.IsReady());
+    }
+    ReportAllocations(state, begin);
+}
+BENCHMARK(BM_ThenChain);
+
+static void BM_TaskQueue(benchmark::State& state)
+{
+    FiberPool pool;
+    TaskQueue queue(pool);
+    std::size_t counter = 0;
+
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        queue.Post([&] { ++counter; });
+        queue.Run();
+    }
+    ReportAllocations(state, begin);
+    benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_TaskQueue);
+
+static void BM_TaskQueueBatch(benchmark::State& state)
+{
+    FiberPool pool;
+    TaskQueue queue(pool);
+    std::size_t counter = 0;
+
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        for (int i = 0; i < 64; ++i)
+        {
+            queue.Post([&] { ++counter; });
+        }
+        queue.Run();
+    }
+    state.SetItemsProcessed(state.iterations() * 64);
+    ReportAllocations(state, begin);
+    state.counters["allocs/task"] = benchmark::Counter(
+        double(allocations.load(std::memory_order_relaxed) - begin) / 64,
+        benchmark::Counter::kAvgIterations);
+    benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_TaskQueueBatch);
+
+static void BM_EventBroadcast(benchmark::State& state)
+{
+    FiberPool pool;
+    Scheduler scheduler;
+    Event<int> event;
+    std::size_t counter = 0;
+
+    std::vector<FiberPtr> waiters;
+    for (int i = 0; i < 16; ++i)
+    {
+        waiters.push_back(pool.Spawn([&] {
+            for (;;)
+            {
+                counter += await event.Wait();
+            }
+        }));
+        waiters.back()->Resume();
+    }
+
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        event.Signal(1);
+        event.Reset();
+        scheduler.Run();
+    }
+    state.SetItemsProcessed(state.iterations() * 16);
+    ReportAllocations(state, begin);
+    benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_EventBroadcast);
+
+static void BM_ChannelTransfer(benchmark::State& state)
+{
+    FiberPool pool;
+    Channel<int> channel(64);
+    std::size_t counter = 0;
+
+    auto receiver = pool.Spawn([&] {
+        for (;;)
+        {
+            counter += await channel.Receive();
+        }
+    });
+    receiver->Resume();
+
+    auto const begin = allocations.load();
+    RunOnFiber(pool, [&] {
+        for (auto _ : state)
+        {
+            await channel.Send(1);
+        }
+    });
+    state.SetItemsProcessed(state.iterations());
+    ReportAllocations(state, begin);
+    benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_ChannelTransfer);
+
+static void BM_FiberMutexUncontended(benchmark::State& state)
+{
+    FiberPool pool;
+    FiberMutex mutex;
+    std::size_t counter = 0;
+
+    auto const begin = allocations.load();
+    RunOnFiber(pool, [&] {
+        for (auto _ : state)
+        {
+            std::lock_guard<FiberMutex> guard(mutex);
+            ++counter;
+        }
+    });
+    ReportAllocations(state, begin);
+    benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_FiberMutexUncontended);
+
+static void BM_FiberMutexHandoff(benchmark::State& state)
+{
+    FiberPool pool;
+    Scheduler scheduler;
+    FiberMutex mutex;
+    std::size_t counter = 0;
+
+    auto waiter = pool.Spawn([&] {
+        for (;;)
+        {
+            {
+                std::lock_guard<FiberMutex> guard(mutex);
+                ++counter;
+            }
+            ThisFiber()->Suspend();
+        }
+    });
+
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        mutex.Lock();
+        waiter->Resume();
+        mutex.Unlock();
+        scheduler.Run();
+    }
+    ReportAllocations(state, begin);
+    benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_FiberMutexHandoff);
+
+static void BM_RemoteFutureRoundTrip(benchmark::State& state)
+{
+    FiberPool pool;
+    Scheduler scheduler;
+    std::size_t counter = 0;
+
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        RemoteFuture<int> future;
+        auto promise = future.GetPromise();
+        FiberPtr fiber =
+            pool.Spawn([&] { counter += await std::move(future); });
+        fiber->Resume();
+
+        // Takes the same path as a resolution from another thread
+        promise.Resolve(1);
+        scheduler.Run();
+    }
+    ReportAllocations(state, begin);
+    benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_RemoteFutureRoundTrip);
+
+static void BM_CancelSuspended(benchmark::State& state)
+{
+    FiberPool pool;
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        FiberPtr fiber = pool.Spawn([] { ThisFiber()->Suspend(); });
+        fiber->Resume();
+        fiber->Cancel();
+    }
+    ReportAllocations(state, begin);
+}
+BENCHMARK(BM_CancelSuspended);
+
+static void BM_FiberScopeCancel(benchmark::State& state)
+{
+    FiberPool pool;
+    pool.Reserve(1000, StackClass::Medium);
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        FiberScope scope(pool);
+        for (int i = 0; i < 1000; ++i)
+        {
+            scope.Spawn([] { ThisFiber()->Suspend(); });
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 1000);
+    ReportAllocations(state, begin);
+}
+BENCHMARK(BM_FiberScopeCancel);
+
+static void BM_IntrusivePtrCopyDrop(benchmark::State& state)
+{
+    FiberPool pool;
+    FiberPtr fiber = pool.Spawn([] {});
+
+    auto const begin = allocations.load();
+    for (auto _ : state)
+    {
+        FiberPtr copy = fiber.Copy();
+        benchmark::DoNotOptimize(copy.Get());
+    }
+    ReportAllocations(state, begin);
+}
+BENCHMARK(BM_IntrusivePtrCopyDrop);
+
+BENCHMARK_MAIN();
@@ -22,12 +22,46 @@
 #include "AsyncImpl.h"
 
 namespace Trinity {
+/// Specifies where the callable passed to Async is executed
+enum class Launch
+{
+    /// The callable is executed on a new Fiber, which allows the caller
+    /// to continue when the callable suspends.
+    Fiber,
+    /// The callable is executed directly on the stack of the caller,
+    /// which doesn't allocate a Fiber and avoids two context switches.
+    ///
+    /// \attention When the callable suspends, the caller is suspended
+    ///            with it, since a suspended stack frame can't be moved
+    ///            to a Fiber afterwards. This is equivalent for callers
+    ///            which await the result immediately.
+    Inline
+};
+
+/// Executes the given callable on a new Fiber and returns a Future
+/// which is resolved with the result of the callable.
 template <typename Callable, typename Trait = Detail::AsyncTrait<
                                  decltype(std::declval<Callable>()())>>
 auto Async(Callable&& callable) -> typename Trait::FutureType
 {
     return Detail::AsyncImpl::Async(std::forward<Callable>(callable));
 }
+
+/// Executes the given callable with the given launch policy and returns
+/// a Future which is resolved with the result of the callable.
+///
+/// See Launch for details.
+template <typename Callable, typename Trait = Detail::AsyncTrait<
+                                 decltype(std::declval<Callable>()())>>
+auto Async(Launch policy, Callable&& callable) -> typename Trait::FutureType
+{
+    if (policy == Launch::Inline)
+    {
+        return Detail::AsyncImpl::AsyncInline(
+            std::forward<Callable>(callable));
+    }
+    return Detail::AsyncImpl::Async(std::forward<Callable>(callable));
+}
 } // namespace Trinity
 
 #endif // TRINITY_ASYNC_ASYNC_HPP_DEFINED
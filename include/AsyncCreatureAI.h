@@ -18,9 +18,12 @@
 #ifndef TRINITY_ASYNC_CREATURE_AI_HPP_DEFINED
 #define TRINITY_ASYNC_CREATURE_AI_HPP_DEFINED
 
+#include <cassert>
 #include <chrono>
+#include <random>
 #include "Await.h"
 #include "Future.h"
+#include "TimerWheel.h"
 
 using namespace std::chrono_literals;
 
@@ -43,7 +46,15 @@ enum class SpellCastResult
 
 class AsyncCreatureAI
 {
+    /// The wheel which drives the timers of this AI, when the AI has
+    /// no TimerWheel, waiting completes immediately.
+    TimerWheel* timers_ = nullptr;
+
   public:
+    AsyncCreatureAI() = default;
+    explicit AsyncCreatureAI(TimerWheel& timers) : timers_(&timers) {}
+    virtual ~AsyncCreatureAI() = default;
+
     virtual void Reset() {}
 
     Future<Unit*> OnEnterCombat()
@@ -65,16 +76,24 @@ class AsyncCreatureAI
         promise.Resolve(SpellCastResult::Ok);
         return future;
     }
-    Future<> Wait(std::chrono::milliseconds)
+    /// Returns a Future which is resolved after the given duration passed
+    Future<> Wait(std::chrono::milliseconds duration)
     {
-        Future<> future;
-        auto promise = future.GetPromise();
-        promise.Resolve();
-        return future;
+        if (!timers_)
+        {
+            return MakeReadyFuture();
+        }
+        return timers_->Wait(duration);
     }
-    Future<> Wait(std::chrono::milliseconds, std::chrono::milliseconds)
+    /// Returns a Future which is resolved after a random duration
+    /// between the given minimum and maximum passed
+    Future<> Wait(std::chrono::milliseconds min, std::chrono::milliseconds max)
     {
-        return MakeReadyFuture();
+        assert(min <= max);
+        static thread_local std::minstd_rand generator;
+        std::uniform_int_distribution<std::chrono::milliseconds::rep>
+            distribution(min.count(), max.count());
+        return Wait(std::chrono::milliseconds(distribution(generator)));
     }
 
     template <typename Callable>
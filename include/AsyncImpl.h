@@ -32,6 +32,12 @@ struct AsyncTrait
 {
     using FutureType = Future<T>;
 
+    template <typename Callable>
+    static FutureType Invoke(Callable&& callable)
+    {
+        return MakeReadyFuture(std::forward<Callable>(callable)());
+    }
+
     template <typename Callable>
     static void Resolve(Promise<T>& promise, Callable&& callable)
     {
@@ -44,6 +50,13 @@ struct AsyncTrait<void>
 {
     using FutureType = Future<>;
 
+    template <typename Callable>
+    static FutureType Invoke(Callable&& callable)
+    {
+        std::forward<Callable>(callable)();
+        return MakeReadyFuture();
+    }
+
     template <typename Callable>
     static void Resolve(Promise<>& promise, Callable&& callable)
     {
@@ -63,12 +76,16 @@ struct AsyncImpl
     {
         using Trait = AsyncTrait<decltype(std::declval<Callable>()())>;
         typename Trait::FutureType future;
-        FiberPtr fiber = ThisFiber()->Pool().Spawn(
+        Fiber* const parent = ThisFiber();
+        FiberPtr fiber = parent->Pool().Spawn(
             [callable = std::forward<Callable>(callable),
              promise = future.GetPromise()]() mutable {
                 Trait::Resolve(promise, std::move(callable));
             });
 
+        // Propagate the cancellation of the parent to the child
+        fiber->SetParent(parent);
+
         // It is important here to create a copy of the FiberPtr since
         // the spawned Fiber could return instantly to resolve the future
         // which would cause a pointer invalidation.
@@ -78,6 +95,13 @@ struct AsyncImpl
         current->Resume();
         return std::move(future);
     }
+
+    template <typename Callable>
+    static auto AsyncInline(Callable&& callable)
+    {
+        using Trait = AsyncTrait<decltype(std::declval<Callable>()())>;
+        return Trait::Invoke(std::forward<Callable>(callable));
+    }
 };
 } // namespace Detail
 } // namespace Trinity
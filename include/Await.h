@@ -25,10 +25,19 @@
 
 namespace Trinity {
 namespace Detail {
+/// Results which are returned as r-value reference are moved into a value,
+/// since the awaited temporary is destroyed afterwards. Results which are
+/// shared by the Awaitable are returned by l-value reference.
+template <typename Awaitable,
+          typename Result = decltype(AwaitableTrait<std::decay_t<Awaitable>>::Unpack(
+              std::declval<Awaitable>()))>
+using AwaitResult = std::conditional_t<std::is_rvalue_reference<Result>::value,
+                                       std::decay_t<Result>, Result>;
+
 struct Awaiter
 {
     template <typename Awaitable>
-    auto operator<<(Awaitable&& awaitable) noexcept(false)
+    AwaitResult<Awaitable> operator<<(Awaitable&& awaitable) noexcept(false)
     {
         static_assert(std::is_rvalue_reference<Awaitable&&>::value,
                       "The awaitable must be passed as r-value reference!");
@@ -26,7 +26,23 @@
 namespace Trinity {
 namespace Detail {
 struct Awaiter;
-}
+
+/// A callback which is invoked once when an Awaitable becomes ready,
+/// used for continuing waiters which aren't Fibers.
+struct Continuation
+{
+    void (*callback)(void*) = nullptr;
+    void* context = nullptr;
+
+    explicit operator bool() const noexcept { return callback != nullptr; }
+
+    void operator()() const
+    {
+        assert(callback && "Tried to invoke an empty Continuation!");
+        callback(context);
+    }
+};
+} // namespace Detail
 
 template <typename T>
 struct AwaitableTrait
@@ -42,6 +58,24 @@ struct AwaitableTrait
 
     /// Returns the resolved result values of the given Awaitable
     static void Unpack(T&& /*awaitable*/) {}
+
+    /// Registers the given Continuation, which is invoked when the Awaitable
+    /// becomes ready. This is optional and required for Awaitables which
+    /// are awaited from stackless coroutines.
+    ///
+    /// Returns false when the Awaitable became ready during the registration,
+    /// in which case the Continuation is never invoked. The Continuation is
+    /// never invoked from inside of this method.
+    static bool OnReady(T& /*awaitable*/, Detail::Continuation /*next*/)
+    {
+        return true;
+    }
+
+    /// Removes the Continuation which was registered through OnReady
+    /// without invoking it. This is optional and required for Awaitables
+    /// which are used inside of WhenAny or Select, and for Awaitables which
+    /// may outlive a waiting combinator.
+    static void Deregister(T& /*awaitable*/) {}
 };
 } // namespace Trinity
 
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_CANCELLATION_TOKEN_HPP_DEFINED
+#define TRINITY_ASYNC_CANCELLATION_TOKEN_HPP_DEFINED
+
+#include <cassert>
+#include "Fiber.h"
+
+namespace Trinity {
+/// A lightweight handle that allows a resolver to poll whether its result
+/// is still needed, for instance to stop an expensive path search early.
+///
+/// The cancellation is requested when the Future connected to the resolving
+/// Fiber is canceled or destroyed, and it propagates from a Fiber to all
+/// Fibers it started through Async.
+///
+/// \attention The token doesn't keep the Fiber alive and is meant to be
+///            used from the Fiber it was retrieved on only.
+class CancellationToken
+{
+    Fiber const* fiber_;
+
+  public:
+    explicit CancellationToken(Fiber const* fiber) noexcept : fiber_(fiber)
+    {
+        assert(fiber_ && "Expected a fiber!");
+    }
+
+    /// Returns the CancellationToken of the currently running Fiber
+    static CancellationToken Current() noexcept
+    {
+        return CancellationToken(ThisFiber());
+    }
+
+    /// Returns true when the result of the Fiber isn't needed anymore,
+    /// this never allocates and can be polled inside long running loops.
+    bool IsCancellationRequested() const noexcept
+    {
+        return fiber_->IsCancellationRequested();
+    }
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_CANCELLATION_TOKEN_HPP_DEFINED
@@ -19,181 +19,306 @@
 #define TRINITY_ASYNC_CHANNEL_HPP_DEFINED
 
 #include <cassert>
-#include <tuple>
+#include <cstddef>
+#include <memory>
+#include <new>
 #include <type_traits>
 #include <utility>
 #include <boost/optional/optional.hpp>
 #include "Awaitable.h"
-#include "StackReference.h"
+#include "Future.h"
+#include "StackListReference.h"
 
 namespace Trinity {
-template <typename...>
+template <typename T>
 class Channel;
+namespace Detail {
+struct ChannelAwaitableTraitBase;
+}
 
-template <typename... Args>
-class Sink : public StackReference<Sink<Args...>, Channel<Args...>>
+/// Represents a send operation on a Channel, which is ready as soon as
+/// its value was buffered or handed to a receiver.
+///
+/// \attention The value isn't sent until the operation is awaited!
+///            The ChannelSendAwaitable may not be moved after it was awaited.
+template <typename T>
+class ChannelSendAwaitable : public StackListReference<ChannelSendAwaitable<T>>
 {
-    friend class Channel<Args...>;
+    friend Channel<T>;
+    friend Detail::ChannelAwaitableTraitBase;
 
-    explicit constexpr Sink(Channel<Args...>* future) noexcept
-        : StackReference<Sink<Args...>, Channel<Args...>>(future)
+    Channel<T>* channel_;
+    /// The value which is sent, as long as the operation is pending
+    boost::optional<T> value_;
+    Detail::Waiter waiter_;
+
+    ChannelSendAwaitable(Channel<T>& channel, T&& value)
+        : channel_(&channel), value_(std::move(value))
     {
     }
 
   public:
-    ~Sink() noexcept
-    {
-        assert((!this->HasRef() || this->GetRef()->IsReady()) &&
-               "The promise is destroyed before the future was resolved!");
-    }
-    constexpr Sink(Sink const&) noexcept = default;
-    constexpr Sink(Sink&&) noexcept = default;
-    constexpr Sink& operator=(Sink const&) noexcept = default;
-    constexpr Sink& operator=(Sink&&) noexcept = default;
+    ChannelSendAwaitable(ChannelSendAwaitable&&) = default;
 
-    /// Returns true when the Sink result isn't needed anymore
-    bool IsCanceled() const noexcept
-    {
-        return !this->HasRef() || this->GteRef()->IsCanceled();
-    }
+    /// Returns true when the value was buffered or received
+    bool IsReady() const noexcept { return !value_; }
+};
 
-    /// Resolves the connected Channel with the given arguments
-    void Resolve(Args... args)
+/// Represents a receive operation on a Channel, which is ready as soon
+/// as a value was taken from the buffer or handed over by a sender.
+///
+/// \attention The ChannelReceiveAwaitable may not be moved after
+///            it was awaited.
+template <typename T>
+class ChannelReceiveAwaitable
+    : public StackListReference<ChannelReceiveAwaitable<T>>
+{
+    friend Channel<T>;
+    friend Detail::ChannelAwaitableTraitBase;
+    friend AwaitableTrait<ChannelReceiveAwaitable>;
+
+    Channel<T>* channel_;
+    /// The received value
+    boost::optional<T> value_;
+    Detail::Waiter waiter_;
+
+    explicit ChannelReceiveAwaitable(Channel<T>& channel) noexcept
+        : channel_(&channel)
     {
-        if (this->HasRef())
-        {
-            // It is valid that the future is destroyed before it was
-            // resolved through the promise in case the execution of
-            // the parent Fiber isn't required anymore.
-            this->GetRef()->ResolveResult(std::forward<Args>(args)...);
-        }
     }
+
+  public:
+    ChannelReceiveAwaitable(ChannelReceiveAwaitable&&) = default;
+
+    /// Returns true when a value was received
+    bool IsReady() const noexcept { return bool(value_); }
 };
 
-/// Represents a an arbitrary count of result values which may be
-/// resolved in the future.
+/// Represents a bounded queue of values between Fibers of the same thread,
+/// which values are stored inside a ring buffer of fixed capacity.
 ///
-/// Use \see await to suspend the currently executed Fiber until
-/// this future is ready.
-template <typename... Args>
-class Channel : public Awaitable,
-                public StackReference<Channel<Args...>, Sink<Args...>>
+/// Sending to a full Channel suspends the sender until a receiver makes
+/// room, and receiving from an empty Channel suspends the receiver until
+/// a value is sent. Values are handed to a waiting receiver directly
+/// without passing the buffer, which also allows a Channel without
+/// capacity where every send waits for its receiver.
+///
+/// The operations are performed when they are awaited, such that they can
+/// be used inside of Select. Waiting operations are linked into intrusive
+/// lists which nodes are placed on the stacks of the waiters, and are
+/// continued in FIFO order.
+///
+/// \attention The Channel is thread unsafe and may not be destroyed
+///            while it is awaited!
+template <typename T>
+class Channel
 {
-    friend Sink<Args...>;
-    friend AwaitableTrait<Channel<Args...>>;
+    friend Detail::ChannelAwaitableTraitBase;
 
-    /// A strong reference to the resolving fiber which causes the
-    /// resolving fiber to be destroyed automatically when this Channel
-    /// is dropped and the result isn't needed anymore.
-    FiberPtr resolver_;
+    using Storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
 
-    /// Caches the result until it was returned
-    boost::optional<std::tuple<Args...>> result_;
+    std::unique_ptr<Storage[]> buffer_;
+    std::size_t const capacity_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    StackListReference<ChannelSendAwaitable<T>> senders_;
+    StackListReference<ChannelReceiveAwaitable<T>> receivers_;
 
-    explicit constexpr Channel(Detail::FutureReadyInitTag,
-                               Args... args) noexcept
-        : result_(std::forward<Args>(args)...)
+  public:
+    /// Creates a Channel which buffers up to capacity values
+    explicit Channel(std::size_t capacity)
+        : buffer_(capacity ? new Storage[capacity] : nullptr),
+          capacity_(capacity)
     {
     }
+    ~Channel()
+    {
+        assert(senders_.IsEmpty() && receivers_.IsEmpty() &&
+               "The Channel was destroyed while it was awaited!");
+        while (size_ > 0)
+        {
+            Pop();
+        }
+    }
+    Channel(Channel const&) = delete;
+    Channel(Channel&&) = delete;
+    Channel& operator=(Channel const&) = delete;
+    Channel& operator=(Channel&&) = delete;
 
-  public:
-    explicit constexpr Channel() noexcept = default;
+    /// Returns an Awaitable which sends the given value when it is awaited.
+    /// The value is handed to a waiting receiver or buffered when possible,
+    /// otherwise the sender is suspended until a receiver takes the value.
+    ChannelSendAwaitable<T> Send(T value)
+    {
+        return ChannelSendAwaitable<T>(*this, std::move(value));
+    }
+
+    /// Returns an Awaitable which receives the next value when it is
+    /// awaited. The value is taken from the buffer or from a waiting sender
+    /// when possible, otherwise the receiver is suspended until a value
+    /// is sent.
+    ChannelReceiveAwaitable<T> Receive()
+    {
+        return ChannelReceiveAwaitable<T>(*this);
+    }
 
-    ~Channel() noexcept = default;
-    constexpr Channel(Channel const&) noexcept = default;
-    constexpr Channel(Channel&&) noexcept = default;
-    constexpr Channel& operator=(Channel const&) noexcept = default;
-    constexpr Channel& operator=(Channel&&) noexcept = default;
+    /// Returns the count of buffered values
+    std::size_t Size() const noexcept { return size_; }
 
-    /// Returns true when the Channel was resolved
-    bool IsReady() const noexcept { return bool(result_); }
-    /// Returns true when the Channel result isn't needed anymore
-    bool IsCanceled() const noexcept { return bool(result_); }
+    /// Returns the count of values which can be buffered
+    std::size_t Capacity() const noexcept { return capacity_; }
 
-    /// Returns a Sink which is connected to this Channel,
-    /// that can be used to resolve the Channel later.
-    Sink<Args...> GetPromise() noexcept
+    /// Returns true when no value is buffered
+    bool IsEmpty() const noexcept { return size_ == 0; }
+
+    /// Returns true when no further value can be buffered
+    bool IsFull() const noexcept { return size_ == capacity_; }
+
+  private:
+    StackListReference<ChannelSendAwaitable<T>>&
+    WaitersOf(ChannelSendAwaitable<T>& /*sender*/) noexcept
+    {
+        return senders_;
+    }
+    StackListReference<ChannelReceiveAwaitable<T>>&
+    WaitersOf(ChannelReceiveAwaitable<T>& /*receiver*/) noexcept
     {
-        assert(!this->HasRef() && "A promise was retrieved already!");
-        assert(!IsReady() && "Don't create a promise for a resolved future!");
-        return Sink<Args...>(this);
+        return receivers_;
     }
 
-  private:
-    void ResolveResult(Args... args)
+    /// Completes the given send operation when possible
+    bool TryComplete(ChannelSendAwaitable<T>& sender)
     {
-        if (!IsCanceled())
+        if (!receivers_.IsEmpty())
         {
-            assert(!IsReady() && "The future is resolved already!");
-            result_.emplace(std::forward<Args>(args)...);
-            assert(IsReady());
-            resolver_ = nullptr;
-            AwaitResume();
+            assert(size_ == 0);
+            ChannelReceiveAwaitable<T>* const receiver = receivers_.Front();
+            receiver->Unlink();
+            receiver->value_.emplace(std::move(*sender.value_));
+            sender.value_ = boost::none;
+            receiver->waiter_.Notify();
+            return true;
         }
+        if (size_ < capacity_)
+        {
+            Push(std::move(*sender.value_));
+            sender.value_ = boost::none;
+            return true;
+        }
+        return false;
     }
-    void SetResolvedFrom(FiberPtr fiber)
+
+    /// Completes the given receive operation when possible
+    bool TryComplete(ChannelReceiveAwaitable<T>& receiver)
     {
-        assert(!resolver_ && "This future has a resolver registered already!");
-        resolver_ = std::move(fiber);
+        if (size_ > 0)
+        {
+            receiver.value_.emplace(Pop());
+
+            // Move the value of the first waiting sender into the room
+            if (!senders_.IsEmpty())
+            {
+                ChannelSendAwaitable<T>* const sender = senders_.Front();
+                sender->Unlink();
+                Push(std::move(*sender->value_));
+                sender->value_ = boost::none;
+                sender->waiter_.Notify();
+            }
+            return true;
+        }
+        if (!senders_.IsEmpty())
+        {
+            ChannelSendAwaitable<T>* const sender = senders_.Front();
+            sender->Unlink();
+            receiver.value_.emplace(std::move(*sender->value_));
+            sender->value_ = boost::none;
+            sender->waiter_.Notify();
+            return true;
+        }
+        return false;
     }
-};
 
-namespace Detail {
-struct FutureFactory
-{
-    template <typename... Args>
-    static constexpr auto CreateFrom(Args&&... args)
+    T* At(std::size_t index) noexcept
     {
-        return Channel<std::decay_t<Args>...>(FutureReadyInitTag{},
-                                              std::forward<Args>(args)...);
+        return reinterpret_cast<T*>(&buffer_[index]);
+    }
+    void Push(T&& value)
+    {
+        assert(size_ < capacity_);
+        std::size_t const index = (head_ + size_) % capacity_;
+        new (At(index)) T(std::move(value));
+        ++size_;
+    }
+    T Pop()
+    {
+        assert(size_ > 0);
+        T* const slot = At(head_);
+        T value = std::move(*slot);
+        slot->~T();
+        head_ = (head_ + 1) % capacity_;
+        --size_;
+        return value;
     }
 };
-} // namespace Detail
 
-/// Creates a resolved ready Channel from the given arguments.
-template <typename... Args>
-constexpr Channel<std::decay_t<Args>...> MakeReadyFuture(Args&&... args)
-{
-    return Detail::FutureFactory::CreateFrom(std::forward<Args>(args)...);
-}
-
-template <>
-struct AwaitableTrait<Channel<>>
+namespace Detail {
+struct ChannelAwaitableTraitBase
 {
-    static bool IsReady(Channel<> const& awaitable)
+    template <typename T>
+    static bool IsReady(T const& operation)
     {
-        return awaitable.IsReady(); //
+        return operation.IsReady();
     }
 
-    static void Unpack(Channel<>&& /*awaitable*/)
+    template <typename T>
+    static void Await(T& operation)
     {
-        // Nothing to do here
+        if (!operation.channel_->TryComplete(operation))
+        {
+            operation.Link(operation.channel_->WaitersOf(operation));
+            operation.waiter_.Suspend();
+        }
     }
-};
-template <typename Arg>
-struct AwaitableTrait<Channel<Arg>>
-{
-    static bool IsReady(Channel<Arg> const& awaitable)
+
+    /// Returns false when the operation was completed right away
+    template <typename T>
+    static bool OnReady(T& operation, Continuation next)
     {
-        return awaitable.IsReady(); //
+        if (operation.channel_->TryComplete(operation))
+        {
+            return false;
+        }
+        operation.waiter_.SetContinuation(next);
+        operation.Link(operation.channel_->WaitersOf(operation));
+        return true;
     }
 
-    static auto Unpack(Channel<Arg>&& awaitable)
+    template <typename T>
+    static void Deregister(T& operation)
     {
-        return std::move(std::get<0>(*awaitable.result_));
+        operation.Unlink();
+        operation.waiter_.Clear();
     }
 };
-template <typename FirstArg, typename SecondArg, typename... Args>
-struct AwaitableTrait<Channel<FirstArg, SecondArg, Args...>>
+} // namespace Detail
+
+template <typename T>
+struct AwaitableTrait<ChannelSendAwaitable<T>>
+    : Detail::ChannelAwaitableTraitBase
 {
-    static bool IsReady(Channel<FirstArg, SecondArg, Args...> const& awaitable)
+    static void Unpack(ChannelSendAwaitable<T>&& /*send*/)
     {
-        return awaitable.IsReady();
+        // Nothing to do here
     }
+};
 
-    static auto Unpack(Channel<FirstArg, SecondArg, Args...>&& awaitable)
+template <typename T>
+struct AwaitableTrait<ChannelReceiveAwaitable<T>>
+    : Detail::ChannelAwaitableTraitBase
+{
+    static T Unpack(ChannelReceiveAwaitable<T>&& receive)
     {
-        return std::move(*awaitable.result_);
+        return std::move(*receive.value_);
     }
 };
 } // namespace Trinity
@@ -19,132 +19,211 @@
 #define TRINITY_ASYNC_EVENT_HPP_DEFINED
 
 #include <cassert>
+#include <cstddef>
 #include <tuple>
-#include <type_traits>
 #include <utility>
 #include <boost/optional/optional.hpp>
 #include "Awaitable.h"
-#include "StackReference.h"
+#include "Future.h"
+#include "StackListReference.h"
 
 namespace Trinity {
 template <typename... Args>
-class Event : public Awaitable
-{
-    friend Sink<Args...>;
-    friend AwaitableTrait<Channel<Args...>>;
+class Event;
+namespace Detail {
+struct EventAwaitableTraitBase;
+}
 
-    /// A strong reference to the resolving fiber which causes the
-    /// resolving fiber to be destroyed automatically when this Channel
-    /// is dropped and the result isn't needed anymore.
-    FiberPtr resolver_;
+/// Represents a single wait operation on an Event, which is linked
+/// into the waiter list of the Event while it is awaited.
+///
+/// \attention The EventAwaitable may not be moved after it was awaited.
+template <typename... Args>
+class EventAwaitable : public StackListReference<EventAwaitable<Args...>>
+{
+    friend Event<Args...>;
+    friend Detail::EventAwaitableTraitBase;
+    friend AwaitableTrait<EventAwaitable>;
 
-    /// Caches the result until it was returned
-    boost::optional<std::tuple<Args...>> result_;
+    Event<Args...>* event_;
+    Detail::Waiter waiter_;
+    /// The values of the signal which made this ready, which are kept
+    /// even if the Event is reset, signaled again or destroyed before
+    /// the waiter is continued.
+    boost::optional<std::tuple<Args...>> values_;
 
-    explicit constexpr Channel(Detail::FutureReadyInitTag,
-                               Args... args) noexcept
-        : result_(std::forward<Args>(args)...)
+  public:
+    explicit EventAwaitable(Event<Args...>& event) : event_(&event)
     {
+        if (event.IsSet())
+        {
+            values_.emplace(event.Get());
+        }
     }
 
+    /// Returns true when the Event is signaled
+    bool IsReady() const noexcept { return values_ || event_->IsSet(); }
+};
+
+/// Represents a resettable broadcast event which can be awaited by many
+/// Fibers at once and repeatedly, for instance to notify AI scripts
+/// about a phase change of their encounter.
+///
+/// Event::Signal continues all waiters in one batch and keeps the Event
+/// signaled until Event::Reset is called, where waiters which await
+/// a signaled Event continue immediately. The waiters are linked into
+/// an intrusive list which nodes are placed on the stacks of the waiters,
+/// such that neither awaiting nor signaling the Event allocates.
+///
+/// \attention The Event may not be destroyed while it is awaited!
+template <typename... Args>
+class Event
+{
+    friend EventAwaitable<Args...>;
+    friend Detail::EventAwaitableTraitBase;
+
+    StackListReference<EventAwaitable<Args...>> waiters_;
+    /// The values of the latest signal
+    boost::optional<std::tuple<Args...>> values_;
+    bool set_ = false;
+
   public:
-    explicit constexpr Channel() noexcept = default;
-
-    ~Channel() noexcept = default;
-    constexpr Channel(Channel const&) noexcept = default;
-    constexpr Channel(Channel&&) noexcept = default;
-    constexpr Channel& operator=(Channel const&) noexcept = default;
-    constexpr Channel& operator=(Channel&&) noexcept = default;
-
-    /// Returns true when the Channel was resolved
-    bool IsReady() const noexcept { return bool(result_); }
-    /// Returns true when the Channel result isn't needed anymore
-    bool IsCanceled() const noexcept { return bool(result_); }
-
-    /// Returns a Sink which is connected to this Channel,
-    /// that can be used to resolve the Channel later.
-    Sink<Args...> GetPromise() noexcept
+    Event() = default;
+    ~Event()
+    {
+        assert(waiters_.IsEmpty() &&
+               "The Event was destroyed while it was awaited!");
+    }
+    Event(Event const&) = delete;
+    Event(Event&&) = delete;
+    Event& operator=(Event const&) = delete;
+    Event& operator=(Event&&) = delete;
+
+    /// Returns true when the Event is signaled
+    bool IsSet() const noexcept { return set_; }
+
+    /// Returns an Awaitable which becomes ready when this Event is signaled
+    /// and which returns a copy of the values it was signaled with.
+    /// This can be used from any count of Fibers at the same time.
+    EventAwaitable<Args...> Wait()
     {
-        assert(!this->HasRef() && "A promise was retrieved already!");
-        assert(!IsReady() && "Don't create a promise for a resolved future!");
-        return Sink<Args...>(this);
+        return EventAwaitable<Args...>(*this);
     }
 
-  private:
-    void ResolveResult(Args... args)
+    /// Signals the Event with the given values, and continues all
+    /// Fibers which are waiting for it. Signaling an Event which is
+    /// signaled already replaces its values, where waiters which were
+    /// continued by an earlier signal keep the values of that signal.
+    /// Returns the count of waiters which were continued.
+    std::size_t Signal(Args... args)
     {
-        if (!IsCanceled())
+        values_.emplace(std::forward<Args>(args)...);
+        set_ = true;
+
+        // Detach the waiters first, since a continued waiter may destroy
+        // this Event. Every waiter is unlinked before it is continued
+        // because it destroys its list node afterwards.
+        StackListReference<EventAwaitable<Args...>> waiters(
+            std::move(waiters_));
+        std::size_t count = 0;
+        while (!waiters.IsEmpty())
         {
-            assert(!IsReady() && "The future is resolved already!");
-            result_.emplace(std::forward<Args>(args)...);
-            assert(IsReady());
-            resolver_ = nullptr;
-            AwaitResume();
+            EventAwaitable<Args...>* const waiter = waiters.Front();
+            waiter->Unlink();
+            waiter->values_.emplace(*values_);
+            waiter->waiter_.Notify();
+            ++count;
         }
+        return count;
     }
-    void SetResolvedFrom(FiberPtr fiber)
+
+    /// Resets the Event, such that it is awaited until the next signal
+    void Reset() noexcept { set_ = false; }
+
+  private:
+    void Register(EventAwaitable<Args...>& waiter)
     {
-        assert(!resolver_ && "This future has a resolver registered already!");
-        resolver_ = std::move(fiber);
+        assert(!IsSet());
+        waiter.Link(waiters_);
+    }
+
+    /// Returns the values of the latest signal
+    std::tuple<Args...> const& Get() const noexcept
+    {
+        assert(values_ && "The Event wasn't signaled yet!");
+        return *values_;
     }
 };
 
 namespace Detail {
-struct FutureFactory
+struct EventAwaitableTraitBase
 {
+    template <typename T>
+    static bool IsReady(T const& awaitable)
+    {
+        return awaitable.IsReady();
+    }
+
+    template <typename T>
+    static void Await(T& awaitable)
+    {
+        awaitable.event_->Register(awaitable);
+        awaitable.waiter_.Suspend();
+    }
+
+    template <typename T>
+    static bool OnReady(T& awaitable, Continuation next)
+    {
+        awaitable.waiter_.SetContinuation(next);
+        awaitable.event_->Register(awaitable);
+        return true;
+    }
+
+    template <typename T>
+    static void Deregister(T& awaitable)
+    {
+        awaitable.Unlink();
+        awaitable.waiter_.Clear();
+    }
+
+    /// Takes the values the awaitable was made ready with, or the values
+    /// of the Event in case it was signaled after the awaitable was created.
     template <typename... Args>
-    static constexpr auto CreateFrom(Args&&... args)
+    static std::tuple<Args...> Take(EventAwaitable<Args...>& awaitable)
     {
-        return Channel<std::decay_t<Args>...>(FutureReadyInitTag{},
-                                              std::forward<Args>(args)...);
+        if (awaitable.values_)
+        {
+            return std::move(*awaitable.values_);
+        }
+        return awaitable.event_->Get();
     }
 };
 } // namespace Detail
 
-/// Creates a resolved ready Channel from the given arguments.
-template <typename... Args>
-constexpr Channel<std::decay_t<Args>...> MakeReadyFuture(Args&&... args)
-{
-    return Detail::FutureFactory::CreateFrom(std::forward<Args>(args)...);
-}
-
 template <>
-struct AwaitableTrait<Channel<>>
+struct AwaitableTrait<EventAwaitable<>> : Detail::EventAwaitableTraitBase
 {
-    static bool IsReady(Channel<> const& awaitable)
-    {
-        return awaitable.IsReady(); //
-    }
-
-    static void Unpack(Channel<>&& /*awaitable*/)
+    static void Unpack(EventAwaitable<>&& /*awaitable*/)
     {
         // Nothing to do here
     }
 };
 template <typename Arg>
-struct AwaitableTrait<Channel<Arg>>
+struct AwaitableTrait<EventAwaitable<Arg>> : Detail::EventAwaitableTraitBase
 {
-    static bool IsReady(Channel<Arg> const& awaitable)
+    static Arg Unpack(EventAwaitable<Arg>&& awaitable)
     {
-        return awaitable.IsReady(); //
-    }
-
-    static auto Unpack(Channel<Arg>&& awaitable)
-    {
-        return std::move(std::get<0>(*awaitable.result_));
+        return std::get<0>(Take(awaitable));
     }
 };
 template <typename FirstArg, typename SecondArg, typename... Args>
-struct AwaitableTrait<Channel<FirstArg, SecondArg, Args...>>
+struct AwaitableTrait<EventAwaitable<FirstArg, SecondArg, Args...>>
+    : Detail::EventAwaitableTraitBase
 {
-    static bool IsReady(Channel<FirstArg, SecondArg, Args...> const& awaitable)
-    {
-        return awaitable.IsReady();
-    }
-
-    static auto Unpack(Channel<FirstArg, SecondArg, Args...>&& awaitable)
+    static std::tuple<FirstArg, SecondArg, Args...>
+    Unpack(EventAwaitable<FirstArg, SecondArg, Args...>&& awaitable)
     {
-        return std::move(*awaitable.result_);
+        return Take(awaitable);
     }
 };
 } // namespace Trinity
@@ -18,19 +18,42 @@
 #ifndef TRINITY_ASYNC_FIBER_HPP_DEFINED
 #define TRINITY_ASYNC_FIBER_HPP_DEFINED
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <boost/context/fiber.hpp>
 #include "IntrusivePtr.h"
 
 namespace Trinity {
 class Fiber;
 class FiberPool;
+class Scheduler;
+namespace Detail {
+struct AsyncImpl;
+}
+
+/// Represents the size class of a Fiber stack, where every class
+/// is recycled separately inside the FiberPool.
+enum class StackClass : std::uint8_t
+{
+    /// A stack for Fibers with a shallow call depth
+    Small,
+    /// The default stack which fits most Fibers
+    Medium,
+    /// A stack for Fibers with a deep call depth
+    Large
+};
 
 /// A managed pointer to a Fiber that which causes the Fiber to stay
 /// alive until all instances of the pointer are destroyed.
 ///
-/// \attention The FiberPtr is thread unsafe and may not be passed
-///            to other threads!
+/// The FiberPtr may be released on any thread, when the last reference
+/// is released on a thread other than the one of the FiberPool,
+/// the Fiber is handed back to its FiberPool which cancels and recycles
+/// the Fiber on its own thread.
+///
+/// \attention The Fiber itself may only be used from the thread
+///            of its FiberPool!
 using FiberPtr = IntrusivePtr<Fiber, StrongWeakType, StrongWeakType::Strong>;
 
 /// A weakly referenced counterpart to FiberPtr
@@ -47,7 +70,7 @@ using WeakFiberPtr = IntrusivePtr<Fiber, StrongWeakType, StrongWeakType::Weak>;
 class Fiber
 {
   public:
-    enum class State
+    enum class State : std::uint8_t
     {
         NotStarted,
         Running,
@@ -57,21 +80,52 @@ class Fiber
 
   private:
     friend FiberPool;
+    friend Scheduler;
+    friend Detail::AsyncImpl;
     State state_ = State::NotStarted;
-    std::size_t strong_count_ = 1;
-    std::size_t weak_count_ = 0;
+    bool scheduled_ = false;
+    StackClass const stack_class_;
+    /// Is true when the stack was painted for measuring its usage
+    bool painted_ = false;
+    /// Is true when the result of this Fiber isn't needed anymore
+    bool cancellation_requested_ = false;
+    std::atomic<std::uint32_t> strong_count_{1};
+    /// Holds an additional reference while any strong reference exists,
+    /// so the last released reference is always a weak one.
+    std::atomic<std::uint32_t> weak_count_{1};
     FiberPtr previous_;
+    /// The Fiber which started this Fiber through Async, its cancellation
+    /// is propagated to this Fiber until one of both Fibers is finished.
+    /// The link doesn't hold a reference, so the stack of a finished parent
+    /// isn't kept alive by the Fibers it started.
+    Fiber* parent_ = nullptr;
+    /// The intrusive list of the Fibers started from this Fiber through Async
+    Fiber* first_child_ = nullptr;
+    Fiber* next_sibling_ = nullptr;
+    Fiber* previous_sibling_ = nullptr;
     FiberPool& pool_;
     void* const stack_;
     boost::context::fiber fiber_;
-
-    explicit Fiber(FiberPool& pool, void* stack) noexcept
-        : pool_(pool), stack_(stack)
+    /// The intrusive link to the next Fiber inside a run queue
+    Fiber* next_ = nullptr;
+    /// The tag the stack usage of this Fiber is accounted to
+    char const* const tag_;
+    /// The intrusive link to the next Fiber which was handed back
+    /// to the FiberPool from another thread.
+    Fiber* returned_next_ = nullptr;
+
+    explicit Fiber(FiberPool& pool, StackClass stack_class, void* stack,
+                   char const* tag) noexcept
+        : stack_class_(stack_class), pool_(pool), stack_(stack), tag_(tag)
     {
     }
 
     void Emplace(boost::context::fiber&& fiber);
     void SetRunning();
+    void SetParent(Fiber* parent) noexcept;
+    /// Unlinks this Fiber from its parent and its children, where the
+    /// children keep the cancellation state they inherited so far.
+    void DetachRelatives() noexcept;
     static boost::context::fiber Finalize(Fiber* fiber);
 
   public:
@@ -98,9 +152,20 @@ class Fiber
     /// This method is safe to use even after the Fiber has finished.
     void Cancel();
 
+    /// Marks the result of this Fiber and all Fibers started from it
+    /// through Async as not needed anymore, without unwinding the Fiber.
+    void RequestCancellation() noexcept { cancellation_requested_ = true; }
+
+    /// Returns true when the cancellation of this Fiber or one of the
+    /// Fibers which started it through Async was requested.
+    bool IsCancellationRequested() const noexcept;
+
     /// Returns the FiberPool the Fiber is originating from
     FiberPool& Pool() noexcept { return pool_; }
 
+    /// Returns the size class of the stack the Fiber is running on
+    StackClass GetStackClass() const noexcept { return stack_class_; }
+
     friend void IncreaseRefCounter(Fiber* fiber, StrongWeakType type) noexcept;
     friend void DecreaseRefCounter(Fiber* fiber, StrongWeakType type) noexcept;
 };
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_FIBER_CONDITION_VARIABLE_HPP_DEFINED
+#define TRINITY_ASYNC_FIBER_CONDITION_VARIABLE_HPP_DEFINED
+
+#include <mutex>
+#include "FiberMutex.h"
+#include "WaitQueue.h"
+
+namespace Trinity {
+/// A condition variable which suspends the current Fiber instead of
+/// blocking the thread, and which is used together with a FiberMutex.
+///
+/// Waiting Fibers are woken in FIFO order. A Fiber which is canceled while
+/// it waits owns the mutex afterwards only if the mutex was free, otherwise
+/// the given lock is released from the mutex without unlocking it.
+///
+/// \attention The FiberConditionVariable is thread unsafe and may only be
+///            used from Fibers of the same thread!
+class FiberConditionVariable
+{
+    Detail::WaitQueue waiters_;
+
+  public:
+    FiberConditionVariable() = default;
+    FiberConditionVariable(FiberConditionVariable const&) = delete;
+    FiberConditionVariable(FiberConditionVariable&&) = delete;
+    FiberConditionVariable& operator=(FiberConditionVariable const&) = delete;
+    FiberConditionVariable& operator=(FiberConditionVariable&&) = delete;
+
+    /// Unlocks the given lock and suspends the current Fiber until it is
+    /// notified, the lock is locked again before this method returns.
+    void Wait(std::unique_lock<FiberMutex>& lock);
+
+    /// Waits until the given predicate returns true
+    template <typename Predicate>
+    void Wait(std::unique_lock<FiberMutex>& lock, Predicate predicate)
+    {
+        while (!predicate())
+        {
+            Wait(lock);
+        }
+    }
+
+    /// Wakes the Fiber which is waiting the longest
+    void NotifyOne() { waiters_.WakeOne(); }
+
+    /// Wakes all waiting Fibers
+    void NotifyAll() { waiters_.WakeAll(); }
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_FIBER_CONDITION_VARIABLE_HPP_DEFINED
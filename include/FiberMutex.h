@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_FIBER_MUTEX_HPP_DEFINED
+#define TRINITY_ASYNC_FIBER_MUTEX_HPP_DEFINED
+
+#include <cassert>
+#include "WaitQueue.h"
+
+namespace Trinity {
+/// A mutex which suspends the current Fiber instead of blocking the thread
+/// while it is locked by another Fiber.
+///
+/// Locking an unlocked mutex never leaves the Fiber, and unlocking hands the
+/// ownership directly to the Fiber which is waiting the longest, so waiting
+/// Fibers can't be overtaken. The mutex satisfies the Lockable requirements,
+/// thus std::lock_guard and std::unique_lock can be used with it.
+///
+/// \attention The FiberMutex is thread unsafe and may only be used
+///            from Fibers of the same thread! The mutex isn't recursive.
+class FiberMutex
+{
+    Detail::WaitQueue waiters_;
+    bool locked_ = false;
+
+  public:
+    FiberMutex() = default;
+    ~FiberMutex() { assert(!locked_ && "The FiberMutex is still locked!"); }
+    FiberMutex(FiberMutex const&) = delete;
+    FiberMutex(FiberMutex&&) = delete;
+    FiberMutex& operator=(FiberMutex const&) = delete;
+    FiberMutex& operator=(FiberMutex&&) = delete;
+
+    /// Locks the mutex and suspends the current Fiber
+    /// while the mutex is locked by another Fiber.
+    void Lock()
+    {
+        if (!locked_)
+        {
+            locked_ = true;
+            return;
+        }
+        LockSlow();
+    }
+
+    /// Locks the mutex when it is unlocked, and returns true on success
+    bool TryLock() noexcept
+    {
+        if (locked_)
+        {
+            return false;
+        }
+        locked_ = true;
+        return true;
+    }
+
+    /// Unlocks the mutex, or passes it to the next waiting Fiber
+    void Unlock();
+
+    /// Returns true when the mutex is locked
+    bool IsLocked() const noexcept { return locked_; }
+
+    void lock() { Lock(); }
+    bool try_lock() noexcept { return TryLock(); }
+    void unlock() { Unlock(); }
+
+  private:
+    void LockSlow();
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_FIBER_MUTEX_HPP_DEFINED
@@ -18,23 +18,78 @@
 #ifndef TRINITY_FIBER_POOL_HPP_DEFINED
 #define TRINITY_FIBER_POOL_HPP_DEFINED
 
+#include <array>
+#include <atomic>
+#include <cassert>
 #include <cstddef>
+#include <exception>
 #include <tuple>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <boost/context/fiber.hpp>
 #include <boost/pool/pool.hpp>
 #include "Fiber.h"
 
+#define TC_FIBER_STRINGIFY_IMPL(VALUE) #VALUE
+#define TC_FIBER_STRINGIFY(VALUE) TC_FIBER_STRINGIFY_IMPL(VALUE)
+
+/// Expands to a tag which identifies the current source location,
+/// that can be passed to FiberPool::SpawnTagged for profiling the stack usage
+/// per spawn site.
+#define TC_SPAWN_SITE __FILE__ ":" TC_FIBER_STRINGIFY(__LINE__)
+
 namespace Trinity {
+/// Represents the measured stack usage of all Fibers with the same tag
+struct StackUsage
+{
+    /// The granularity of the histogram in bytes
+    static constexpr std::size_t BucketSize = 1024;
+    static constexpr std::size_t Buckets = 64;
+
+    /// The tag the Fibers were spawned with or a nullptr
+    char const* tag = nullptr;
+    /// The count of Fibers which were measured
+    std::size_t samples = 0;
+    /// The highest count of bytes that was used by any Fiber
+    std::size_t max = 0;
+    /// The sum of the used bytes of all measured Fibers
+    std::size_t total = 0;
+    /// The count of Fibers per used kilobyte of stack
+    std::array<std::size_t, Buckets> histogram{};
+
+    /// Returns the average count of used bytes
+    std::size_t Mean() const noexcept { return samples ? total / samples : 0; }
+
+    /// Returns the upper bound of used bytes of the given fraction
+    /// of all measured Fibers, for instance 0.99 for the 99th percentile.
+    std::size_t Percentile(double fraction) const noexcept;
+};
+
 /// Represents the origin of a Fiber.
 /// The FiberPool is responsible for recyling the Fibers after usage
 /// in order to improve the speed and memory footprint of spawned Fibers.
 ///
+/// Fibers whose last reference is released on another thread are pushed
+/// onto a lock-free return queue, which is drained by the thread of the
+/// FiberPool before it allocates new Fibers or through FiberPool::Reclaim.
+///
+/// When built with the TC_FIBER_ARENA option the stacks are carved out of
+/// lazily committed arenas, and the pages of recycled Large stacks are
+/// returned to the operating system. Small and Medium stacks are too small
+/// to be worth releasing and keep their pages committed for reuse.
+///
 /// \attention The FiberPool is thread unsafe and may not be passed
 ///            or used to from multiple threads!
 class FiberPool
 {
     friend void DecreaseRefCounter(Fiber*, StrongWeakType) noexcept;
 
+    /// The thread the FiberPool was created on
+    std::thread::id const owner_;
+    /// The head of the Fibers which were returned from other threads
+    std::atomic<Fiber*> returned_{nullptr};
+
     struct PoolAllocator
     {
         typedef std::size_t size_type;
@@ -43,11 +98,19 @@ class FiberPool
         static char* malloc(size_type bytes);
         static void free(char* block);
     };
-    boost::pool<PoolAllocator> pool_;
+    boost::pool<PoolAllocator> small_;
+    boost::pool<PoolAllocator> medium_;
+    boost::pool<PoolAllocator> large_;
 
-#ifndef NDEBUG
+    /// The count of Fibers which are currently allocated
     std::size_t allocated_ = 0;
-#endif
+    /// The highest count of Fibers which may be allocated at the same time,
+    /// zero means that the count is unlimited.
+    std::size_t max_fibers_ = 0;
+
+    bool profile_stacks_ = false;
+    bool tune_stacks_ = false;
+    std::unordered_map<char const*, StackUsage> usage_;
 
     struct FiberAllocator
     {
@@ -68,10 +131,71 @@ class FiberPool
     ///
     /// \attention By default the Fiber isn't executed automatically
     ///            and thus must be invoked through Fiber::Resume.
+    ///            Spawning a Fiber while the FiberPool is exhausted
+    ///            terminates the process, use FiberPool::TrySpawn instead.
     template <typename Callable>
     FiberPtr Spawn(Callable&& callable)
     {
-        auto alloc = AllocateFiber();
+        return Spawn(StackClass::Medium, std::forward<Callable>(callable));
+    }
+
+    /// Creates a fiber which invokes the given callable on a stack
+    /// which provides at least the given count of bytes.
+    ///
+    /// See FiberPool::Spawn and FiberPool::ClassOf for details.
+    template <typename Callable>
+    FiberPtr Spawn(std::size_t stack_hint, Callable&& callable)
+    {
+        return Spawn(ClassOf(stack_hint), std::forward<Callable>(callable));
+    }
+
+    /// Creates a fiber which invokes the given callable on a stack
+    /// of the given size class.
+    ///
+    /// See FiberPool::Spawn for details.
+    template <typename Callable>
+    FiberPtr Spawn(StackClass stack_class, Callable&& callable)
+    {
+        return SpawnTagged(stack_class, nullptr,
+                           std::forward<Callable>(callable));
+    }
+
+    /// Creates a fiber which invokes the given callable, where the
+    /// stack usage of the Fiber is accounted to the given tag.
+    /// When the stack tuning is enabled, the stack class is chosen
+    /// from the usage that was measured for the tag so far.
+    ///
+    /// \attention The tag is compared by its address and is required to
+    ///            outlive the FiberPool, like a string literal or
+    ///            TC_SPAWN_SITE does.
+    ///
+    /// See FiberPool::Spawn for details.
+    template <typename Callable>
+    FiberPtr SpawnTagged(char const* tag, Callable&& callable)
+    {
+        return SpawnTagged(SelectClass(tag), tag,
+                           std::forward<Callable>(callable));
+    }
+
+    /// Creates a fiber which invokes the given callable on a stack
+    /// of the given size class, where the stack usage of the Fiber
+    /// is accounted to the given tag.
+    ///
+    /// See FiberPool::Spawn for details.
+    template <typename Callable>
+    FiberPtr SpawnTagged(StackClass stack_class, char const* tag,
+                         Callable&& callable)
+    {
+        assert(!IsExhausted() &&
+               "Tried to spawn a Fiber while the FiberPool is exhausted, "
+               "use FiberPool::TrySpawn instead!");
+        if (IsExhausted())
+        {
+            // Exceeding the limit would grow the memory usage without bound
+            std::terminate();
+        }
+
+        auto alloc = AllocateFiber(stack_class, tag);
         alloc.fiber->Emplace(boost::context::fiber(
             std::allocator_arg, alloc.pre, FiberAllocator{},
             [callable = std::forward<Callable>(callable)](
@@ -91,6 +215,93 @@ class FiberPool
         return std::move(alloc.fiber);
     }
 
+    /// Creates a fiber which invokes the given callable like
+    /// FiberPool::Spawn does, but returns an empty FiberPtr instead
+    /// when the maximum count of Fibers is reached.
+    template <typename Callable>
+    FiberPtr TrySpawn(Callable&& callable)
+    {
+        return TrySpawn(StackClass::Medium, std::forward<Callable>(callable));
+    }
+
+    /// Creates a fiber which invokes the given callable on a stack
+    /// of the given size class, or returns an empty FiberPtr
+    /// when the maximum count of Fibers is reached.
+    ///
+    /// See FiberPool::TrySpawn for details.
+    template <typename Callable>
+    FiberPtr TrySpawn(StackClass stack_class, Callable&& callable)
+    {
+        if (IsExhausted())
+        {
+            return FiberPtr{};
+        }
+        return Spawn(stack_class, std::forward<Callable>(callable));
+    }
+
+    /// Returns the usable stack size of the given class in bytes
+    static std::size_t SizeOf(StackClass stack_class) noexcept;
+
+    /// Returns the smallest stack class which provides at least
+    /// the given count of bytes.
+    ///
+    /// \attention Requesting more bytes than the Large stack class
+    ///            provides terminates the process.
+    static StackClass ClassOf(std::size_t bytes) noexcept;
+
+    /// Enables the measurement of the stack usage of the Fibers spawned
+    /// afterwards. Their stack is painted with a known pattern on spawn,
+    /// and the highest touched address is measured when they are recycled.
+    void SetStackProfiling(bool enabled) noexcept;
+
+    /// Enables choosing the stack class of tagged spawns from the stack
+    /// usage that was measured for the tag so far, which implies the
+    /// profiling of the stack usage.
+    void SetStackTuning(bool enabled) noexcept;
+
+    /// Returns the measured stack usage per tag
+    std::vector<StackUsage> StackReport() const;
+
+    /// Allocates the stacks of the given count of Fibers ahead of time
+    /// and touches their pages, so spawning up to that count of Fibers
+    /// doesn't allocate memory or page fault afterwards.
+    void Reserve(std::size_t count,
+                 StackClass stack_class = StackClass::Medium);
+
+    /// Limits the count of Fibers which are alive at the same time,
+    /// where zero removes the limit. Fibers which are alive already
+    /// are kept even if they exceed the new limit.
+    void SetMaxFibers(std::size_t max_fibers) noexcept
+    {
+        max_fibers_ = max_fibers;
+    }
+
+    /// Returns the maximum count of Fibers or zero when it is unlimited
+    std::size_t MaxFibers() const noexcept { return max_fibers_; }
+
+    /// Returns the count of Fibers which are alive
+    std::size_t Size() const noexcept { return allocated_; }
+
+    /// Returns true when no further Fibers can be spawned
+    /// until a living Fiber is recycled.
+    bool IsExhausted() const noexcept
+    {
+        return (max_fibers_ != 0) && (allocated_ >= max_fibers_);
+    }
+
+    /// Cancels and recycles the Fibers whose last reference was released
+    /// on another thread and returns their count.
+    ///
+    /// \attention This may only be called from the thread of the FiberPool!
+    std::size_t Reclaim() noexcept;
+
+    /// Returns the utilization of the Fiber limit, where 1 means that
+    /// the FiberPool is exhausted, and 0 when there is no limit.
+    double Pressure() const noexcept
+    {
+        return max_fibers_ ? double(allocated_) / double(max_fibers_) : 0.;
+    }
+
   private:
     struct FiberAllocation
     {
@@ -102,8 +313,16 @@ class FiberPool
         {
         }
     };
-    FiberAllocation AllocateFiber();
+    boost::pool<PoolAllocator>& PoolOf(StackClass stack_class) noexcept;
+    StackClass SelectClass(char const* tag) const;
+    FiberAllocation AllocateFiber(StackClass stack_class, char const* tag);
+    void MeasureStack(Fiber* fiber, std::size_t size);
 
+    bool IsOwningThread() const noexcept
+    {
+        return std::this_thread::get_id() == owner_;
+    }
+    void Return(Fiber* fiber) noexcept;
     void Recycle(Fiber* fiber) noexcept;
 };
 } // namespace Trinity
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_FIBER_SCOPE_HPP_DEFINED
+#define TRINITY_ASYNC_FIBER_SCOPE_HPP_DEFINED
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "Awaitable.h"
+#include "Fiber.h"
+#include "FiberPool.h"
+#include "Future.h"
+
+namespace Trinity {
+class FiberScope;
+
+/// Represents an Awaitable which becomes ready when all Fibers
+/// of a FiberScope are finished or canceled.
+///
+/// \attention The FiberScopeJoinAwaitable may not be moved
+///            after it was awaited.
+class FiberScopeJoinAwaitable
+{
+    friend AwaitableTrait<FiberScopeJoinAwaitable>;
+
+    friend FiberScope;
+
+    /// The joined scope, which is reset when the scope continued
+    /// this Awaitable since the scope may be destroyed afterwards.
+    FiberScope* scope_;
+    Detail::Waiter waiter_;
+
+  public:
+    explicit FiberScopeJoinAwaitable(FiberScope& scope) : scope_(&scope) {}
+    FiberScopeJoinAwaitable(FiberScopeJoinAwaitable&&) = default;
+    FiberScopeJoinAwaitable& operator=(FiberScopeJoinAwaitable&&) = default;
+    /// Removes this Awaitable from the scope, in case the waiter
+    /// was unwound before the scope was joined.
+    ~FiberScopeJoinAwaitable() { Deregister(); }
+
+    /// Returns true when no Fiber of the scope is running anymore
+    bool IsReady() const noexcept;
+
+  private:
+    void Register() noexcept;
+    void Deregister() noexcept;
+};
+
+/// Owns all Fibers which are spawned through it, such that a group
+/// of Fibers (for instance all Fibers of a creature) can be awaited
+/// or canceled together.
+///
+/// The Fibers are only referenced by the scope, destroying the scope
+/// cancels the Fibers which are still running and recycles all of them
+/// in one pass.
+///
+/// \attention The FiberScope is thread unsafe and may not be passed
+///            or used to from multiple threads!
+class FiberScope
+{
+    friend FiberScopeJoinAwaitable;
+
+    FiberPool& pool_;
+    /// All Fibers of this scope, including finished ones which
+    /// weren't swept yet.
+    std::vector<FiberPtr> fibers_;
+    /// The count of Fibers which are not finished yet
+    std::size_t running_ = 0;
+    /// The pending FiberScope::Join
+    FiberScopeJoinAwaitable* joiner_ = nullptr;
+    std::size_t sweep_threshold_ = 64;
+
+  public:
+    /// Creates a FiberScope which spawns its Fibers from the given pool
+    explicit FiberScope(FiberPool& pool) noexcept : pool_(pool) {}
+    /// Cancels and recycles all Fibers of this scope
+    ~FiberScope();
+    FiberScope(FiberScope const&) = delete;
+    FiberScope(FiberScope&&) = delete;
+    FiberScope& operator=(FiberScope const&) = delete;
+    FiberScope& operator=(FiberScope&&) = delete;
+
+    /// Spawns a Fiber which is owned by this scope and starts it
+    /// immediately, the callable must accept the signature of `void()`.
+    template <typename Callable>
+    void Spawn(Callable&& callable)
+    {
+        Sweep();
+        ++running_;
+        fibers_.push_back(pool_.Spawn(
+            [this, callable = std::forward<Callable>(callable)]() mutable {
+                callable();
+                OnFinished();
+            }));
+
+        // The vector could be reallocated by Fibers which are spawned
+        // from the started Fiber.
+        Fiber* const fiber = fibers_.back().Get();
+        fiber->Resume();
+    }
+
+    /// Returns an Awaitable which becomes ready once all Fibers
+    /// of this scope are finished or canceled.
+    FiberScopeJoinAwaitable Join() noexcept
+    {
+        return FiberScopeJoinAwaitable(*this);
+    }
+
+    /// Requests the cancellation of all Fibers of this scope, and cancels
+    /// and recycles them afterwards. A pending FiberScope::Join is
+    /// continued when any Fiber was running.
+    ///
+    /// \attention This may not be called from one of the Fibers
+    ///            of this scope.
+    void Cancel();
+
+    /// Returns the count of Fibers which are not finished yet
+    std::size_t Size() const noexcept { return running_; }
+
+    /// Returns true when no Fiber of this scope is running
+    bool IsEmpty() const noexcept { return running_ == 0; }
+
+  private:
+    void Sweep();
+    void OnFinished();
+    void NotifyJoiner();
+};
+
+inline bool FiberScopeJoinAwaitable::IsReady() const noexcept
+{
+    return !scope_ || scope_->IsEmpty();
+}
+
+inline void FiberScopeJoinAwaitable::Register() noexcept
+{
+    assert(!scope_->joiner_ && "The FiberScope is joined already!");
+    scope_->joiner_ = this;
+}
+
+inline void FiberScopeJoinAwaitable::Deregister() noexcept
+{
+    if (scope_ && (scope_->joiner_ == this))
+    {
+        scope_->joiner_ = nullptr;
+    }
+    waiter_.Clear();
+}
+
+template <>
+struct AwaitableTrait<FiberScopeJoinAwaitable>
+{
+    using Type = FiberScopeJoinAwaitable;
+
+    static bool IsReady(Type const& join) { return join.IsReady(); }
+
+    static void Await(Type& join)
+    {
+        join.Register();
+        join.waiter_.Suspend();
+    }
+
+    static void Unpack(Type&& /*join*/) {}
+
+    static bool OnReady(Type& join, Detail::Continuation next)
+    {
+        join.waiter_.SetContinuation(next);
+        join.Register();
+        return true;
+    }
+
+    static void Deregister(Type& join) { join.Deregister(); }
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_FIBER_SCOPE_HPP_DEFINED
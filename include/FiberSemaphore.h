@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_FIBER_SEMAPHORE_HPP_DEFINED
+#define TRINITY_ASYNC_FIBER_SEMAPHORE_HPP_DEFINED
+
+#include <cstddef>
+#include "WaitQueue.h"
+
+namespace Trinity {
+/// A counting semaphore which suspends the current Fiber instead of
+/// blocking the thread while no permit is available, for instance to limit
+/// the count of Fibers which run an expensive operation at the same time.
+///
+/// Acquiring an available permit never leaves the Fiber, and a released
+/// permit is handed directly to the Fiber which is waiting the longest.
+///
+/// \attention The FiberSemaphore is thread unsafe and may only be used
+///            from Fibers of the same thread!
+class FiberSemaphore
+{
+    Detail::WaitQueue waiters_;
+    std::size_t count_;
+
+  public:
+    /// Creates a semaphore with the given count of available permits
+    explicit FiberSemaphore(std::size_t count) noexcept : count_(count) {}
+    FiberSemaphore(FiberSemaphore const&) = delete;
+    FiberSemaphore(FiberSemaphore&&) = delete;
+    FiberSemaphore& operator=(FiberSemaphore const&) = delete;
+    FiberSemaphore& operator=(FiberSemaphore&&) = delete;
+
+    /// Takes a permit and suspends the current Fiber
+    /// while no permit is available.
+    void Acquire()
+    {
+        if (count_ > 0)
+        {
+            --count_;
+            return;
+        }
+        AcquireSlow();
+    }
+
+    /// Takes a permit when one is available, and returns true on success
+    bool TryAcquire() noexcept
+    {
+        if (count_ == 0)
+        {
+            return false;
+        }
+        --count_;
+        return true;
+    }
+
+    /// Returns the given count of permits, which are handed
+    /// to the waiting Fibers first.
+    void Release(std::size_t count = 1);
+
+    /// Returns the count of available permits
+    std::size_t Count() const noexcept { return count_; }
+
+  private:
+    void AcquireSlow();
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_FIBER_SEMAPHORE_HPP_DEFINED
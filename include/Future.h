@@ -19,15 +19,20 @@
 #define TRINITY_ASYNC_FUTURE_HPP_DEFINED
 
 #include <cassert>
+#include <cstddef>
+#include <new>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 #include <boost/optional/optional.hpp>
 #include "Awaitable.h"
+#include "Scheduler.h"
 #include "StackReference.h"
 
 namespace Trinity {
 template <typename...>
+class Promise;
+template <typename...>
 class Future;
 namespace Detail {
 struct AsyncImpl;
@@ -36,6 +41,93 @@ struct FutureAwaitableTraitBase;
 struct FutureReadyInitTag
 {
 };
+
+/// Tracks the Fiber or the Continuation which waits for an Awaitable
+/// that is resolved by other means than a Promise.
+class Waiter
+{
+    WeakFiberPtr fiber_;
+    Continuation continuation_;
+
+  public:
+    /// Returns true when a Fiber or a Continuation is waiting
+    bool IsWaiting() const noexcept
+    {
+        return bool(fiber_) || bool(continuation_);
+    }
+
+    /// Suspends the current Fiber until Notify is called
+    void Suspend()
+    {
+        assert(!IsWaiting() && "The Awaitable is awaited already!");
+        Fiber* const fiber = ThisFiber();
+        fiber_ = WeakFiberPtr(fiber);
+        fiber->Suspend();
+    }
+
+    /// Registers the Continuation which is invoked on Notify
+    void SetContinuation(Continuation next)
+    {
+        assert(!IsWaiting() && "The Awaitable is awaited already!");
+        continuation_ = next;
+    }
+
+    /// Drops the registered Continuation without invoking it
+    void Clear() noexcept { continuation_ = {}; }
+
+    /// Continues the waiting Fiber or invokes the Continuation,
+    /// which may destroy this Waiter.
+    void Notify()
+    {
+        if (fiber_)
+        {
+            Wakeup(fiber_.Get());
+        }
+        else if (continuation_)
+        {
+            std::exchange(continuation_, {})();
+        }
+    }
+};
+
+/// Describes the Future which is returned by Future::Then for
+/// a continuation with the given result type.
+template <typename T>
+struct ThenTrait
+{
+    using FutureType = Future<T>;
+    using PromiseType = Promise<T>;
+
+    template <typename P, typename Callable, typename Values,
+              std::size_t... I>
+    static void Resolve(P& promise, Callable& callable,
+                        Values& values, std::index_sequence<I...>)
+    {
+        promise.Resolve(callable(std::move(std::get<I>(values))...));
+    }
+};
+template <>
+struct ThenTrait<void>
+{
+    using FutureType = Future<>;
+    using PromiseType = Promise<>;
+
+    template <typename P, typename Callable, typename Values,
+              std::size_t... I>
+    static void Resolve(P& promise, Callable& callable,
+                        Values& values, std::index_sequence<I...>)
+    {
+        callable(std::move(std::get<I>(values))...);
+        promise.Resolve();
+    }
+};
+
+template <typename Callable, typename PromiseType>
+struct ThenRecord
+{
+    Callable callable;
+    PromiseType promise;
+};
 } // namespace Detail
 
 /// The Promise represents a Future resolver with an extremely low memory
@@ -66,7 +158,7 @@ class Promise : public StackReference<Promise<Args...>, Future<Args...>>
     /// Returns true when the Promise result isn't needed anymore
     bool IsCanceled() const noexcept
     {
-        return !this->HasRef() || this->GteRef()->IsCanceled();
+        return !this->HasRef() || this->GetRef()->IsCanceled();
     }
 
     /// Resolves the connected Future with the given arguments
@@ -95,10 +187,15 @@ class Future : public StackReference<Future<Args...>, Promise<Args...>>
     friend Detail::FutureAwaitableTraitBase;
     friend Promise<Args...>;
     friend AwaitableTrait<Future<Args...>>;
+    template <typename...>
+    friend class SharedFuture;
 
     /// The fiber which waits for the completion of this result
     WeakFiberPtr waiting_fiber_;
 
+    /// Is invoked on completion when the waiter isn't a fiber
+    Detail::Continuation continuation_;
+
     /// A strong reference to the resolving fiber which causes the
     /// resolving fiber to be destroyed automatically when this Future
     /// is dropped and the result isn't needed anymore.
@@ -107,24 +204,80 @@ class Future : public StackReference<Future<Args...>, Promise<Args...>>
     /// Caches the result until it was returned
     boost::optional<std::tuple<Args...>> result_;
 
+    /// Is true when the Future was canceled through Future::Cancel
+    bool canceled_ = false;
+
+    /// The size of the inline buffer which stores the continuation
+    /// attached through Future::Then together with its Promise.
+    static constexpr std::size_t ThenBufferSize = 4 * sizeof(void*);
+
+    /// Stores the continuation attached through Future::Then
+    std::aligned_storage_t<ThenBufferSize, alignof(void*)> then_;
+    /// Destroys the continuation inside the buffer, or is a nullptr
+    /// when there is no continuation.
+    void (*then_destroy_)(void*) = nullptr;
+
     explicit constexpr Future(Detail::FutureReadyInitTag, Args... args) noexcept
-        : result_(std::forward<Args>(args)...)
+        : result_(boost::in_place_init, std::forward<Args>(args)...)
     {
     }
 
   public:
     explicit constexpr Future() noexcept = default;
 
-    ~Future() noexcept = default;
-    constexpr Future(Future const&) = default;
-    constexpr Future(Future&&) = default;
-    constexpr Future& operator=(Future const&) = default;
-    constexpr Future& operator=(Future&&) = default;
+    ~Future() noexcept
+    {
+        // Detach from the Promise before the resolver is released,
+        // since canceling the resolving Fiber destroys the Promise.
+        this->Unlink();
+        ReleaseResolver();
+        DestroyThen();
+    }
+    Future(Future const&) = delete;
+    Future(Future&& right) noexcept
+        : StackReference<Future<Args...>, Promise<Args...>>(std::move(right)),
+          waiting_fiber_(std::move(right.waiting_fiber_)),
+          continuation_(std::exchange(right.continuation_, {})),
+          resolver_(std::move(right.resolver_)),
+          result_(std::move(right.result_)),
+          canceled_(right.canceled_)
+    {
+        assert(!right.then_destroy_ &&
+               "A Future with an attached continuation may not be moved!");
+    }
+    Future& operator=(Future const&) = delete;
+    Future& operator=(Future&& right) noexcept
+    {
+        assert(!then_destroy_ && !right.then_destroy_ &&
+               "A Future with an attached continuation may not be moved!");
+
+        StackReference<Future<Args...>, Promise<Args...>>::operator=(
+            std::move(right));
+        waiting_fiber_ = std::move(right.waiting_fiber_);
+        continuation_ = std::exchange(right.continuation_, {});
+        ReleaseResolver();
+        resolver_ = std::move(right.resolver_);
+        result_ = std::move(right.result_);
+        canceled_ = right.canceled_;
+        return *this;
+    }
 
     /// Returns true when the Future was resolved
     bool IsReady() const noexcept { return bool(result_); }
-    /// Returns true when the Future result isn't needed anymore
-    bool IsCanceled() const noexcept { return bool(result_); }
+    /// Returns true when the Future was canceled through Future::Cancel
+    bool IsCanceled() const noexcept { return canceled_; }
+
+    /// Drops the result of this Future, which disconnects the Promise
+    /// and releases the resolving Fiber, that is canceled when there is
+    /// no other strong reference to it. The Future is never resolved
+    /// afterwards.
+    void Cancel() noexcept
+    {
+        this->Unlink();
+        continuation_ = {};
+        canceled_ = true;
+        ReleaseResolver();
+    }
 
     /// Returns a Promise which is connected to this Future,
     /// that can be used to resolve the Future later.
@@ -135,8 +288,54 @@ class Future : public StackReference<Future<Args...>, Promise<Args...>>
         return Promise<Args...>(this);
     }
 
-    // template<typename T>
-    // Future& Then(T&& callable) { return *this;}
+    /// Attaches the given callable as continuation, which is invoked with
+    /// the result values of this Future directly on the stack which
+    /// resolves this Future, without spawning a Fiber.
+    /// Returns a Future which is resolved with the result of the callable.
+    ///
+    /// The continuation is stored inside an inline buffer of this Future
+    /// and thus doesn't allocate. When this Future is ready already,
+    /// the callable is invoked immediately.
+    ///
+    /// \attention This Future has to stay alive and may not be moved until
+    ///            it was resolved, it can't be awaited afterwards and the
+    ///            result values are moved into the callable.
+    template <typename Callable>
+    auto Then(Callable&& callable) &
+    {
+        using Trait = Detail::ThenTrait<decltype(
+            std::declval<Callable&>()(std::declval<Args>()...))>;
+        using Record = Detail::ThenRecord<std::decay_t<Callable>,
+                                          typename Trait::PromiseType>;
+
+        static_assert(sizeof(Record) <= ThenBufferSize &&
+                          alignof(Record) <= alignof(void*),
+                      "The continuation is too large for the inline buffer "
+                      "of the Future!");
+        assert(!waiting_fiber_ && !continuation_ && !then_destroy_ &&
+               "The Future is awaited already!");
+
+        typename Trait::FutureType future;
+        if (IsReady())
+        {
+            auto promise = future.GetPromise();
+            Trait::Resolve(promise, callable, *result_,
+                           std::index_sequence_for<Args...>{});
+            return future;
+        }
+
+        new (&then_) Record{std::forward<Callable>(callable), future.GetPromise()};
+        then_destroy_ = [](void* record) {
+            static_cast<Record*>(record)->~Record();
+        };
+        continuation_ = Detail::Continuation{&InvokeThen<Trait, Record>, this};
+        return future;
+    }
+
+    /// The continuation would be destroyed together with the temporary
+    /// Future, use Then on a Future which outlives its resolution instead.
+    template <typename Callable>
+    auto Then(Callable&& callable) && = delete;
 
   private:
     void ResolveResult(Args... args)
@@ -153,8 +352,44 @@ class Future : public StackReference<Future<Args...>, Promise<Args...>>
                 assert(!(waiting_fiber_->Is(Fiber::State::Finished) ||
                          waiting_fiber_->Is(Fiber::State::Canceled)));
 
-                waiting_fiber_->Resume();
+                Wakeup(waiting_fiber_.Get());
             }
+            else if (continuation_)
+            {
+                // The continuation may destroy this Future
+                std::exchange(continuation_, {})();
+            }
+        }
+    }
+    template <typename Trait, typename Record>
+    static void InvokeThen(void* self)
+    {
+        auto* const future = static_cast<Future*>(self);
+
+        // Take the continuation and the result from this Future first,
+        // since resolving the Promise may destroy this Future.
+        Record record = std::move(*reinterpret_cast<Record*>(&future->then_));
+        future->DestroyThen();
+        std::tuple<Args...> values = std::move(*future->result_);
+
+        Trait::Resolve(record.promise, record.callable, values,
+                       std::index_sequence_for<Args...>{});
+    }
+    /// Releases the resolving Fiber, which requests its cancellation
+    /// in case the Fiber is kept alive through other references.
+    void ReleaseResolver() noexcept
+    {
+        if (resolver_)
+        {
+            resolver_->RequestCancellation();
+            resolver_ = nullptr;
+        }
+    }
+    void DestroyThen() noexcept
+    {
+        if (then_destroy_)
+        {
+            std::exchange(then_destroy_, nullptr)(&then_);
         }
     }
     void SetResolvedFrom(FiberPtr fiber)
@@ -196,12 +431,29 @@ struct FutureAwaitableTraitBase
     static void Await(T&& future)
     {
         Fiber* const fiber = ThisFiber();
-        assert(!future.waiting_fiber_ &&
+        assert(!future.waiting_fiber_ && !future.continuation_ &&
                "await was used on this Future already!");
 
         future.waiting_fiber_ = WeakFiberPtr(fiber);
         fiber->Suspend();
     }
+
+    template <typename T>
+    static bool OnReady(T&& future, Continuation next)
+    {
+        assert(!future.waiting_fiber_ && !future.continuation_ &&
+               "The Future is awaited already!");
+        assert(!future.IsReady());
+
+        future.continuation_ = next;
+        return true;
+    }
+
+    template <typename T>
+    static void Deregister(T&& future)
+    {
+        future.continuation_ = {};
+    }
 };
 } // namespace Detail
 
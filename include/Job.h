@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_JOB_HPP_DEFINED
+#define TRINITY_ASYNC_JOB_HPP_DEFINED
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Trinity {
+namespace Detail {
+/// A type erased and move only callable of the signature `void()`.
+///
+/// In contrast to std::function the Job doesn't require the wrapped callable
+/// to be copyable, which makes it possible to capture Futures and FiberPtrs.
+/// Small callables are stored inside the Job itself, such that posting
+/// them doesn't allocate, larger ones are moved to the heap.
+class Job
+{
+    /// The size of the inline buffer which stores small callables
+    static constexpr std::size_t BufferSize = 4 * sizeof(void*);
+
+    using Buffer = std::aligned_storage_t<BufferSize, alignof(void*)>;
+
+    struct Operations
+    {
+        void (*invoke)(void* storage);
+        /// Moves the callable into the empty target and destroys the source
+        void (*relocate)(void* source, void* target) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <typename Callable>
+    static constexpr bool IsInline() noexcept
+    {
+        return (sizeof(Callable) <= BufferSize) &&
+               (alignof(Callable) <= alignof(void*)) &&
+               std::is_nothrow_move_constructible<Callable>::value;
+    }
+
+    /// Stores the callable inside the buffer
+    template <typename Callable>
+    struct InlineOperations
+    {
+        static void Invoke(void* storage)
+        {
+            (*static_cast<Callable*>(storage))();
+        }
+        static void Relocate(void* source, void* target) noexcept
+        {
+            new (target) Callable(std::move(*static_cast<Callable*>(source)));
+            static_cast<Callable*>(source)->~Callable();
+        }
+        static void Destroy(void* storage) noexcept
+        {
+            static_cast<Callable*>(storage)->~Callable();
+        }
+        static Operations const& Get() noexcept
+        {
+            static constexpr Operations operations{&Invoke, &Relocate,
+                                                   &Destroy};
+            return operations;
+        }
+    };
+
+    /// Stores a pointer to the heap allocated callable inside the buffer
+    template <typename Callable>
+    struct HeapOperations
+    {
+        static void Invoke(void* storage)
+        {
+            (**static_cast<Callable**>(storage))();
+        }
+        static void Relocate(void* source, void* target) noexcept
+        {
+            new (target) Callable*(*static_cast<Callable**>(source));
+        }
+        static void Destroy(void* storage) noexcept
+        {
+            delete *static_cast<Callable**>(storage);
+        }
+        static Operations const& Get() noexcept
+        {
+            static constexpr Operations operations{&Invoke, &Relocate,
+                                                   &Destroy};
+            return operations;
+        }
+    };
+
+    Buffer storage_;
+    /// The operations of the stored callable, or a nullptr
+    /// when the Job is empty.
+    Operations const* operations_ = nullptr;
+
+  public:
+    Job() noexcept = default;
+    template <typename Callable,
+              typename = std::enable_if_t<
+                  !std::is_same<std::decay_t<Callable>, Job>::value>>
+    explicit Job(Callable&& callable)
+    {
+        using Type = std::decay_t<Callable>;
+        Construct<Type>(std::forward<Callable>(callable),
+                        std::integral_constant<bool, IsInline<Type>()>{});
+    }
+    ~Job() { Reset(); }
+    Job(Job const&) = delete;
+    Job(Job&& right) noexcept { Take(right); }
+    Job& operator=(Job const&) = delete;
+    Job& operator=(Job&& right) noexcept
+    {
+        if (this != &right)
+        {
+            Reset();
+            Take(right);
+        }
+        return *this;
+    }
+
+    /// Invokes the wrapped callable
+    void operator()()
+    {
+        assert(operations_ && "Tried to invoke an empty Job!");
+        operations_->invoke(&storage_);
+    }
+
+    explicit operator bool() const noexcept { return operations_ != nullptr; }
+
+  private:
+    template <typename Type, typename Callable>
+    void Construct(Callable&& callable, std::true_type /*inline*/)
+    {
+        new (&storage_) Type(std::forward<Callable>(callable));
+        operations_ = &InlineOperations<Type>::Get();
+    }
+    template <typename Type, typename Callable>
+    void Construct(Callable&& callable, std::false_type /*inline*/)
+    {
+        new (&storage_) Type*(new Type(std::forward<Callable>(callable)));
+        operations_ = &HeapOperations<Type>::Get();
+    }
+    void Take(Job& right) noexcept
+    {
+        if (right.operations_)
+        {
+            right.operations_->relocate(&right.storage_, &storage_);
+            operations_ = std::exchange(right.operations_, nullptr);
+        }
+    }
+    void Reset() noexcept
+    {
+        if (operations_)
+        {
+            std::exchange(operations_, nullptr)->destroy(&storage_);
+        }
+    }
+};
+} // namespace Detail
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_JOB_HPP_DEFINED
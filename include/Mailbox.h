@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_MAILBOX_HPP_DEFINED
+#define TRINITY_ASYNC_MAILBOX_HPP_DEFINED
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <boost/optional/optional.hpp>
+#include "Awaitable.h"
+#include "Future.h"
+#include "StackListReference.h"
+
+#ifndef __linux__
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace Trinity {
+template <typename T>
+class Mailbox;
+
+namespace Detail {
+/// Signals an idle owner thread about new messages. This is backed by an
+/// eventfd on Linux, which can also be polled through an event loop.
+class MailboxSignal
+{
+#ifdef __linux__
+    int fd_;
+#else
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool notified_ = false;
+#endif
+    std::atomic<bool> signaled_{false};
+
+  public:
+    MailboxSignal();
+    ~MailboxSignal();
+    MailboxSignal(MailboxSignal const&) = delete;
+    MailboxSignal(MailboxSignal&&) = delete;
+    MailboxSignal& operator=(MailboxSignal const&) = delete;
+    MailboxSignal& operator=(MailboxSignal&&) = delete;
+
+    /// Wakes the owner, where only the first notification after
+    /// a reset requires a system call.
+    ///
+    /// \attention This method is threadsafe.
+    void Notify() noexcept
+    {
+        if (!signaled_.exchange(true, std::memory_order_seq_cst))
+        {
+            Raise();
+        }
+    }
+
+    /// Clears the signal before the messages are drained
+    void Reset() noexcept;
+
+    /// Blocks until the signal is raised or the timeout expired.
+    /// Returns true when the signal was raised.
+    bool Wait(std::chrono::milliseconds timeout) noexcept;
+
+    /// Returns the file descriptor which becomes readable when the signal
+    /// is raised, or -1 when the platform doesn't support it.
+    int NativeHandle() const noexcept;
+
+  private:
+    void Raise() noexcept;
+};
+} // namespace Detail
+
+/// Represents a receive operation on a Mailbox, which is ready as soon
+/// as a message was taken from the Mailbox.
+///
+/// \attention The MailboxReceiveAwaitable may not be moved after
+///            it was awaited.
+template <typename T>
+class MailboxReceiveAwaitable
+    : public StackListReference<MailboxReceiveAwaitable<T>>
+{
+    friend Mailbox<T>;
+    friend AwaitableTrait<MailboxReceiveAwaitable>;
+
+    Mailbox<T>* mailbox_;
+    /// The received message
+    boost::optional<T> value_;
+    Detail::Waiter waiter_;
+
+    explicit MailboxReceiveAwaitable(Mailbox<T>& mailbox) noexcept
+        : mailbox_(&mailbox)
+    {
+    }
+
+  public:
+    MailboxReceiveAwaitable(MailboxReceiveAwaitable&&) = default;
+
+    /// Returns true when a message was received
+    bool IsReady() const noexcept { return bool(value_); }
+};
+
+/// Represents a bounded lock-free multiple producer single consumer queue,
+/// which passes messages from foreign threads to the Fibers of the thread
+/// that created the Mailbox.
+///
+/// Any thread may post messages without locking, while the messages are
+/// received on the owning thread only. Mailbox::Drain hands the queued
+/// messages to the waiting receivers in one batch, and is meant to be
+/// called once per pass before the Scheduler is run. An idle owner can
+/// block on Mailbox::Wait, or poll the Mailbox::NativeHandle.
+///
+/// The queue is a ring buffer of fixed capacity where every slot carries
+/// a sequence number, so posting neither allocates nor locks.
+///
+/// \attention All methods except Mailbox::Post, Mailbox::TryPost and
+///            Mailbox::NativeHandle may be called from the owning
+///            thread only. The Mailbox may not be destroyed while
+///            it is awaited!
+template <typename T>
+class Mailbox
+{
+    friend AwaitableTrait<MailboxReceiveAwaitable<T>>;
+
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t const mask_;
+    std::thread::id const owner_;
+    /// The producers and the consumer are placed on different cache lines
+    alignas(64) std::atomic<std::size_t> enqueue_{0};
+    alignas(64) std::size_t dequeue_ = 0;
+    StackListReference<MailboxReceiveAwaitable<T>> receivers_;
+    Detail::MailboxSignal signal_;
+
+  public:
+    /// Creates a Mailbox which queues at least capacity messages,
+    /// the capacity is rounded up to the next power of two.
+    explicit Mailbox(std::size_t capacity)
+        : cells_(new Cell[RoundUp(capacity)]),
+          mask_(RoundUp(capacity) - 1),
+          owner_(std::this_thread::get_id())
+    {
+        for (std::size_t i = 0; i <= mask_; ++i)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    ~Mailbox()
+    {
+        assert(receivers_.IsEmpty() &&
+               "The Mailbox was destroyed while it was awaited!");
+        while (TryReceive())
+        {
+        }
+    }
+    Mailbox(Mailbox const&) = delete;
+    Mailbox(Mailbox&&) = delete;
+    Mailbox& operator=(Mailbox const&) = delete;
+    Mailbox& operator=(Mailbox&&) = delete;
+
+    /// Queues the given message and wakes the owner.
+    /// Returns false and leaves the message untouched
+    /// when the Mailbox is full.
+    ///
+    /// \attention This method is threadsafe.
+    template <typename U>
+    bool TryPost(U&& value)
+    {
+        std::size_t position = enqueue_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &cells_[position & mask_];
+            std::size_t const sequence =
+                cell->sequence.load(std::memory_order_acquire);
+            auto const difference = static_cast<std::intptr_t>(sequence) -
+                                    static_cast<std::intptr_t>(position);
+            if (difference == 0)
+            {
+                if (enqueue_.compare_exchange_weak(position, position + 1,
+                                                   std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (&cell->storage) T(std::forward<U>(value));
+        cell->sequence.store(position + 1, std::memory_order_release);
+        signal_.Notify();
+        return true;
+    }
+
+    /// Queues the given message and wakes the owner,
+    /// where the calling thread yields while the Mailbox is full.
+    ///
+    /// \attention This method is threadsafe.
+    template <typename U>
+    void Post(U&& value)
+    {
+        assert(!IsOwningThread() &&
+               "The owner would wait for itself on a full Mailbox!");
+        while (!TryPost(std::forward<U>(value)))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    /// Returns an Awaitable which becomes ready when a message is taken
+    /// from this Mailbox. When it is awaited a queued message is received
+    /// immediately, otherwise the receiver waits for the next call
+    /// to Mailbox::Drain.
+    MailboxReceiveAwaitable<T> Receive()
+    {
+        assert(IsOwningThread());
+        return MailboxReceiveAwaitable<T>(*this);
+    }
+
+    /// Takes the next queued message without waiting
+    boost::optional<T> TryReceive()
+    {
+        assert(IsOwningThread());
+        Cell& cell = cells_[dequeue_ & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeue_ + 1)
+        {
+            return boost::none;
+        }
+
+        T* const slot = reinterpret_cast<T*>(&cell.storage);
+        boost::optional<T> value(std::move(*slot));
+        slot->~T();
+        cell.sequence.store(dequeue_ + mask_ + 1, std::memory_order_release);
+        ++dequeue_;
+        return value;
+    }
+
+    /// Hands the queued messages to the waiting receivers and continues
+    /// them through Wakeup, so they are queued on the Scheduler if there
+    /// is one. Messages which arrive without a waiting receiver stay
+    /// queued. Returns the count of messages which were received.
+    std::size_t Drain()
+    {
+        assert(IsOwningThread());
+        signal_.Reset();
+
+        std::size_t count = 0;
+        while (!receivers_.IsEmpty())
+        {
+            boost::optional<T> value = TryReceive();
+            if (!value)
+            {
+                break;
+            }
+
+            MailboxReceiveAwaitable<T>* const receiver = receivers_.Front();
+            receiver->Unlink();
+            receiver->value_ = std::move(value);
+            receiver->waiter_.Notify();
+            ++count;
+        }
+        return count;
+    }
+
+    /// Blocks the owning thread until a message was posted since the last
+    /// call to Mailbox::Drain, or the timeout expired.
+    /// Returns true when a message was posted.
+    bool Wait(std::chrono::milliseconds timeout)
+    {
+        assert(IsOwningThread());
+        return signal_.Wait(timeout);
+    }
+
+    /// Returns a file descriptor which becomes readable when a message
+    /// was posted, or -1 when the platform doesn't support it.
+    ///
+    /// \attention This method is threadsafe.
+    int NativeHandle() const noexcept { return signal_.NativeHandle(); }
+
+    /// Returns the count of messages which can be queued
+    std::size_t Capacity() const noexcept { return mask_ + 1; }
+
+    /// Returns true when this is called from the thread
+    /// which owns the Mailbox.
+    bool IsOwningThread() const noexcept
+    {
+        return owner_ == std::this_thread::get_id();
+    }
+
+  private:
+    static std::size_t RoundUp(std::size_t capacity) noexcept
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        return size;
+    }
+};
+
+template <typename T>
+struct AwaitableTrait<MailboxReceiveAwaitable<T>>
+{
+    using Type = MailboxReceiveAwaitable<T>;
+
+    static bool IsReady(Type const& receive) { return receive.IsReady(); }
+
+    static void Await(Type& receive)
+    {
+        if (!TryComplete(receive))
+        {
+            receive.Link(receive.mailbox_->receivers_);
+            receive.waiter_.Suspend();
+        }
+    }
+
+    static T Unpack(Type&& receive) { return std::move(*receive.value_); }
+
+    /// Returns false when a message was received right away
+    static bool OnReady(Type& receive, Detail::Continuation next)
+    {
+        if (TryComplete(receive))
+        {
+            return false;
+        }
+        receive.waiter_.SetContinuation(next);
+        receive.Link(receive.mailbox_->receivers_);
+        return true;
+    }
+
+    static void Deregister(Type& receive)
+    {
+        receive.Unlink();
+        receive.waiter_.Clear();
+    }
+
+  private:
+    /// Receivers which are waiting already are served first
+    static bool TryComplete(Type& receive)
+    {
+        if (receive.mailbox_->receivers_.IsEmpty())
+        {
+            receive.value_ = receive.mailbox_->TryReceive();
+        }
+        return receive.IsReady();
+    }
+};
+
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_MAILBOX_HPP_DEFINED
@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_REMOTE_FUTURE_HPP_DEFINED
+#define TRINITY_ASYNC_REMOTE_FUTURE_HPP_DEFINED
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <boost/optional/optional.hpp>
+#include "Awaitable.h"
+#include "Future.h"
+#include "Scheduler.h"
+
+namespace Trinity {
+template <typename...>
+class RemotePromise;
+template <typename...>
+class RemoteFuture;
+namespace Detail {
+struct RemoteFutureAwaitableTraitBase;
+
+/// The state which is shared between a RemoteFuture and its RemotePromise.
+///
+/// The result is published through the atomic status, the waiter and the
+/// Scheduler are only accessed from the thread which owns the RemoteFuture.
+template <typename... Args>
+class RemoteState : public RemoteTask
+{
+    template <typename...>
+    friend class Trinity::RemotePromise;
+    template <typename...>
+    friend class Trinity::RemoteFuture;
+    friend RemoteFutureAwaitableTraitBase;
+    template <typename>
+    friend struct Trinity::AwaitableTrait;
+
+    enum class Status
+    {
+        Pending,
+        Waiting,
+        Resolved
+    };
+
+    std::atomic<Status> status_{Status::Pending};
+    /// The RemoteFuture and the RemotePromise own a reference each,
+    /// the reference of the RemotePromise is passed to the Scheduler
+    /// when the result is posted.
+    std::atomic<std::size_t> references_{2};
+    std::atomic<bool> canceled_{false};
+    Scheduler* scheduler_ = nullptr;
+    Waiter waiter_;
+    bool promised_ = false;
+    boost::optional<std::tuple<Args...>> result_;
+
+    RemoteState() noexcept : RemoteTask(&Run) {}
+
+    void Release() noexcept
+    {
+        if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    bool IsReady() const noexcept
+    {
+        return status_.load(std::memory_order_acquire) == Status::Resolved;
+    }
+
+    /// Announces a waiter on the owning thread, returns false when
+    /// the result was published in the meantime.
+    bool Register()
+    {
+        scheduler_ = Scheduler::Current();
+        assert(scheduler_ &&
+               "A RemoteFuture can only be awaited on a thread which has a "
+               "Scheduler!");
+
+        Status expected = Status::Pending;
+        return status_.compare_exchange_strong(expected, Status::Waiting,
+                                               std::memory_order_acq_rel) ||
+               (expected == Status::Waiting);
+    }
+
+    /// Publishes the result, which may be called from any thread
+    template <typename... T>
+    void Resolve(T&&... args)
+    {
+        if (canceled_.load(std::memory_order_acquire))
+        {
+            Release();
+            return;
+        }
+
+        result_.emplace(std::forward<T>(args)...);
+        if (status_.exchange(Status::Resolved, std::memory_order_acq_rel) ==
+            Status::Waiting)
+        {
+            // Never continue the waiter on this thread
+            scheduler_->Post(this);
+        }
+        else
+        {
+            Release();
+        }
+    }
+
+    static void Run(RemoteTask* task)
+    {
+        auto* const state = static_cast<RemoteState*>(task);
+
+        // The RemoteFuture is destroyed when it was canceled
+        if (!state->canceled_.load(std::memory_order_relaxed))
+        {
+            state->waiter_.Notify();
+        }
+        state->Release();
+    }
+};
+} // namespace Detail
+
+/// The resolver of a RemoteFuture, which can be moved to
+/// and resolved on an arbitrary thread.
+///
+/// \attention The RemotePromise is required to resolve the RemoteFuture
+///            before destruction!
+template <typename... Args>
+class RemotePromise
+{
+    friend class RemoteFuture<Args...>;
+
+    Detail::RemoteState<Args...>* state_;
+
+    explicit RemotePromise(Detail::RemoteState<Args...>* state) noexcept
+        : state_(state)
+    {
+    }
+
+  public:
+    ~RemotePromise() noexcept
+    {
+        if (state_)
+        {
+            assert(IsCanceled() &&
+                   "The promise is destroyed before the future was resolved!");
+            state_->Release();
+        }
+    }
+    RemotePromise(RemotePromise const&) = delete;
+    RemotePromise(RemotePromise&& right) noexcept
+        : state_(std::exchange(right.state_, nullptr))
+    {
+    }
+    RemotePromise& operator=(RemotePromise const&) = delete;
+    RemotePromise& operator=(RemotePromise&& right) noexcept
+    {
+        std::swap(state_, right.state_);
+        return *this;
+    }
+
+    /// Returns true when the RemoteFuture was destroyed and
+    /// the result isn't needed anymore.
+    ///
+    /// \attention This method is threadsafe.
+    bool IsCanceled() const noexcept
+    {
+        return !state_ || state_->canceled_.load(std::memory_order_acquire);
+    }
+
+    /// Resolves the connected RemoteFuture with the given arguments.
+    /// The Fiber which awaits the RemoteFuture is continued on the
+    /// Scheduler of its own thread and never on the calling thread.
+    ///
+    /// \attention This method is threadsafe.
+    void Resolve(Args... args)
+    {
+        assert(state_ && "The promise was resolved already!");
+        std::exchange(state_, nullptr)->Resolve(std::forward<Args>(args)...);
+    }
+};
+
+/// A Future which can be resolved from an arbitrary thread, for instance
+/// by a database or pathfinding worker.
+///
+/// The RemoteFuture itself is bound to the thread which created it, and
+/// it can only be awaited on a thread which has a Scheduler. A result
+/// that is resolved from another thread is posted to that Scheduler,
+/// which continues the waiting Fiber the next time it runs. A sleeping
+/// thread is woken up through the wakeup callback of its Scheduler,
+/// like the workers of a WorkerPool are.
+///
+/// The state shared with the RemotePromise is allocated once, use a plain
+/// Future when the result is resolved on the same thread, which is free
+/// of any atomic operation.
+///
+/// \attention The Scheduler of the awaiting thread has to outlive
+///            the resolution of the RemotePromise!
+template <typename... Args>
+class RemoteFuture
+{
+    friend Detail::RemoteFutureAwaitableTraitBase;
+    friend AwaitableTrait<RemoteFuture<Args...>>;
+
+    Detail::RemoteState<Args...>* state_;
+
+  public:
+    explicit RemoteFuture() : state_(new Detail::RemoteState<Args...>()) {}
+    ~RemoteFuture() noexcept
+    {
+        if (state_)
+        {
+            state_->canceled_.store(true, std::memory_order_release);
+            if (!state_->promised_)
+            {
+                // Drop the reference which was reserved for the promise
+                state_->Release();
+            }
+            state_->Release();
+        }
+    }
+    RemoteFuture(RemoteFuture const&) = delete;
+    RemoteFuture(RemoteFuture&& right) noexcept
+        : state_(std::exchange(right.state_, nullptr))
+    {
+    }
+    RemoteFuture& operator=(RemoteFuture const&) = delete;
+    RemoteFuture& operator=(RemoteFuture&& right) noexcept
+    {
+        std::swap(state_, right.state_);
+        return *this;
+    }
+
+    /// Returns true when the RemoteFuture was resolved
+    bool IsReady() const noexcept
+    {
+        assert(state_ && "The RemoteFuture was moved!");
+        return state_->IsReady();
+    }
+
+    /// Returns a RemotePromise which is connected to this RemoteFuture,
+    /// that can be passed to another thread to resolve the RemoteFuture.
+    RemotePromise<Args...> GetPromise() noexcept
+    {
+        assert(state_ && "The RemoteFuture was moved!");
+        assert(!state_->promised_ && "A promise was retrieved already!");
+        state_->promised_ = true;
+        return RemotePromise<Args...>(state_);
+    }
+};
+
+namespace Detail {
+struct RemoteFutureAwaitableTraitBase
+{
+    template <typename T>
+    static bool IsReady(T const& future)
+    {
+        return future.IsReady();
+    }
+
+    template <typename T>
+    static void Await(T& future)
+    {
+        if (future.state_->Register())
+        {
+            future.state_->waiter_.Suspend();
+        }
+    }
+
+    template <typename T>
+    static bool OnReady(T& future, Continuation next)
+    {
+        if (!future.state_->Register())
+        {
+            return false;
+        }
+        future.state_->waiter_.SetContinuation(next);
+        return true;
+    }
+
+    template <typename T>
+    static void Deregister(T& future)
+    {
+        future.state_->waiter_.Clear();
+    }
+};
+} // namespace Detail
+
+template <>
+struct AwaitableTrait<RemoteFuture<>> : Detail::RemoteFutureAwaitableTraitBase
+{
+    static void Unpack(RemoteFuture<>&& /*awaitable*/)
+    {
+        // Nothing to do here
+    }
+};
+template <typename Arg>
+struct AwaitableTrait<RemoteFuture<Arg>>
+    : Detail::RemoteFutureAwaitableTraitBase
+{
+    static auto Unpack(RemoteFuture<Arg>&& awaitable)
+    {
+        return std::move(std::get<0>(*awaitable.state_->result_));
+    }
+};
+template <typename FirstArg, typename SecondArg, typename... Args>
+struct AwaitableTrait<RemoteFuture<FirstArg, SecondArg, Args...>>
+    : Detail::RemoteFutureAwaitableTraitBase
+{
+    static auto Unpack(RemoteFuture<FirstArg, SecondArg, Args...>&& awaitable)
+    {
+        return std::move(*awaitable.state_->result_);
+    }
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_REMOTE_FUTURE_HPP_DEFINED
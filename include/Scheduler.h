@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_SCHEDULER_HPP_DEFINED
+#define TRINITY_ASYNC_SCHEDULER_HPP_DEFINED
+
+#include <atomic>
+#include <cstddef>
+#include "Awaitable.h"
+#include "Fiber.h"
+
+namespace Trinity {
+class Scheduler;
+
+namespace Detail {
+/// A stackless continuation like a suspended coroutine, which is queued
+/// on the run queue of the Scheduler of its thread.
+struct ScheduledTask
+{
+    explicit ScheduledTask(void (*run)(ScheduledTask*)) noexcept : run(run) {}
+
+    /// Is invoked by the Scheduler, the task may be destroyed
+    /// by the invocation.
+    void (*const run)(ScheduledTask*);
+    ScheduledTask* next = nullptr;
+    /// The Scheduler the task is queued on, or a nullptr
+    Scheduler* scheduler = nullptr;
+};
+
+/// A task which is posted to a Scheduler from an arbitrary thread
+/// and which is run on the thread of the Scheduler.
+struct RemoteTask
+{
+    explicit RemoteTask(void (*run)(RemoteTask*)) noexcept : run(run) {}
+
+    /// Is invoked on the thread of the Scheduler, the task may be
+    /// destroyed by the invocation.
+    void (*const run)(RemoteTask*);
+    RemoteTask* next = nullptr;
+};
+} // namespace Detail
+
+/// Collects Fibers which became ready for execution in a FIFO run queue
+/// and resumes them from a single drain loop.
+///
+/// While a Scheduler exists on a thread, resolving a Future on that thread
+/// only marks the waiting Fiber or Task as ready instead of resuming it on
+/// the stack of the resolver. Ready Tasks are kept in a separate FIFO queue
+/// which is drained after the ready Fibers. This bounds the latency of the resolver and keeps
+/// Fibers from being resumed in deeply nested chains.
+///
+/// The Scheduler registers itself for the thread it was created on,
+/// and restores the previous Scheduler of the thread on destruction.
+///
+/// Other threads can't touch the run queue, instead they post tasks
+/// to a separate lock-free queue, which are run on the thread of the
+/// Scheduler as soon as its run queue is empty. A thread which sleeps
+/// while it has nothing to do can register a wakeup callback, which is
+/// invoked by the posting thread.
+///
+/// \attention The Scheduler is thread unsafe and may not be passed
+///            or used to from multiple threads!
+class Scheduler
+{
+    Scheduler* const previous_;
+    Fiber* head_ = nullptr;
+    Fiber* tail_ = nullptr;
+    Detail::ScheduledTask* tasks_head_ = nullptr;
+    Detail::ScheduledTask* tasks_tail_ = nullptr;
+    /// The tasks posted from other threads in LIFO order
+    std::atomic<Detail::RemoteTask*> remote_{nullptr};
+    /// Is invoked from the posting thread when a task was posted
+    /// while no other task was queued.
+    Detail::Continuation wakeup_;
+
+  public:
+    explicit Scheduler() noexcept;
+    ~Scheduler();
+    Scheduler(Scheduler const&) = delete;
+    Scheduler(Scheduler&&) = delete;
+    Scheduler& operator=(Scheduler const&) = delete;
+    Scheduler& operator=(Scheduler&&) = delete;
+
+    /// Marks the given suspended Fiber as ready and appends it
+    /// to the run queue. Scheduling a Fiber which is queued already
+    /// has no effect.
+    void Schedule(Fiber* fiber);
+
+    /// Appends the given task to the run queue of the Tasks, scheduling
+    /// a task which is queued already has no effect. The task has to stay
+    /// alive until it was run or removed through Unschedule.
+    void Schedule(Detail::ScheduledTask* task) noexcept;
+
+    /// Removes the given queued task from the run queue without running it
+    void Unschedule(Detail::ScheduledTask* task) noexcept;
+
+    /// Queues the given task which is run on the thread of this Scheduler
+    /// by RunOne or Run, the task has to stay alive until it was run.
+    ///
+    /// \attention This method is threadsafe.
+    void Post(Detail::RemoteTask* task) noexcept;
+
+    /// Sets the callback which is invoked from the posting thread when a
+    /// task was posted while no other task was queued, for instance to wake
+    /// up the thread of this Scheduler while it sleeps. The callback has
+    /// to be threadsafe.
+    ///
+    /// \attention The callback has to be set before tasks are posted.
+    void SetWakeup(Detail::Continuation wakeup) noexcept { wakeup_ = wakeup; }
+
+    /// Resumes the Fiber on the front of the run queue, or runs the
+    /// front Task when no Fiber is ready. The tasks posted from other
+    /// threads are run first when both queues are empty.
+    /// Returns false when the run queue was empty.
+    bool RunOne();
+
+    /// Resumes the queued Fibers and Tasks until the run queue is empty,
+    /// including the ones that became ready while draining.
+    /// Returns the count of Fibers and Tasks which were taken from
+    /// the run queue.
+    std::size_t Run();
+
+    /// Returns true when no Fiber or Task is ready and no task was posted
+    bool IsEmpty() const noexcept
+    {
+        return (head_ == nullptr) && (tasks_head_ == nullptr) &&
+               (remote_.load(std::memory_order_relaxed) == nullptr);
+    }
+
+    /// Returns the Scheduler which is registered for the current thread,
+    /// or a nullptr when there is none.
+    static Scheduler* Current() noexcept;
+
+  private:
+    /// Runs the tasks which were posted from other threads
+    void RunRemote();
+};
+
+/// Continues the execution of the given suspended Fiber.
+///
+/// The Fiber is queued on the Scheduler of the current thread if there is
+/// one, otherwise the Fiber is resumed immediately.
+void Wakeup(Fiber* fiber);
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_SCHEDULER_HPP_DEFINED
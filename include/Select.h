@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_SELECT_HPP_DEFINED
+#define TRINITY_ASYNC_SELECT_HPP_DEFINED
+
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "Awaitable.h"
+#include "Future.h"
+#include "WhenAll.h"
+
+namespace Trinity {
+/// The result of Select, which contains the index of the input that fired
+/// together with all inputs, where only the winning input is ready.
+template <typename... Awaitables>
+struct SelectResult
+{
+    std::size_t index;
+    std::tuple<Awaitables...> inputs;
+};
+
+/// Represents a wait operation on multiple Awaitables at once, which becomes
+/// ready as soon as one of them fires, for instance a receive operation
+/// on one of several Channels, a timer or a Future.
+///
+/// The first input that fires claims the operation, and all other inputs
+/// are deregistered synchronously before the waiter is continued.
+/// In contrast to WhenAny the other inputs are not canceled, so Channel
+/// operations which didn't fire never take or lose a value.
+/// The registration records are the inputs themselves, which are stored
+/// inline, thus no allocation is required.
+///
+/// \attention The SelectAwaitable may not be moved after it was awaited.
+template <typename... Awaitables>
+class SelectAwaitable
+{
+    friend AwaitableTrait<SelectAwaitable>;
+
+    static constexpr std::size_t NoWinner =
+        std::numeric_limits<std::size_t>::max();
+
+    std::tuple<Awaitables...> inputs_;
+    std::size_t winner_ = NoWinner;
+    /// The count of leading inputs which were registered
+    std::size_t registered_ = 0;
+    /// Is true while the inputs are registered
+    bool registering_ = false;
+    Detail::Waiter waiter_;
+
+  public:
+    explicit SelectAwaitable(Awaitables&&... inputs)
+        : inputs_(std::move(inputs)...)
+    {
+    }
+    SelectAwaitable(SelectAwaitable&&) = default;
+    SelectAwaitable& operator=(SelectAwaitable&&) = default;
+    /// Removes this operation from the registered inputs,
+    /// in case the waiter was unwound before any input fired.
+    ~SelectAwaitable() { Deregister(); }
+
+    /// Returns true when any input fired
+    bool IsReady() const
+    {
+        return (winner_ != NoWinner) ||
+               (FindReady(std::index_sequence_for<Awaitables...>{}) !=
+                NoWinner);
+    }
+
+  private:
+    template <std::size_t... I>
+    std::size_t FindReady(std::index_sequence<I...>) const
+    {
+        std::size_t ready = NoWinner;
+        (void)std::initializer_list<int>{
+            ((ready == NoWinner) &&
+                     AwaitableTrait<Awaitables>::IsReady(std::get<I>(inputs_))
+                 ? (ready = I, 0)
+                 : 0)...};
+        return ready;
+    }
+
+    /// Registers the inputs in order until one of them fires, which can
+    /// happen immediately for inputs that are completed on registration.
+    /// Returns false when an input fired during the registration.
+    template <std::size_t... I>
+    bool Register(std::index_sequence<I...>)
+    {
+        assert(registered_ == 0 && "The SelectAwaitable is awaited already!");
+
+        // The waiter isn't notified before all inputs were registered
+        registering_ = true;
+        (void)std::initializer_list<int>{(Register<I>(), 0)...};
+        registering_ = false;
+        return winner_ == NoWinner;
+    }
+    template <std::size_t I>
+    void Register()
+    {
+        using Input = std::tuple_element_t<I, std::tuple<Awaitables...>>;
+        if (winner_ != NoWinner)
+        {
+            return;
+        }
+
+        Input& input = std::get<I>(inputs_);
+        if (AwaitableTrait<Input>::IsReady(input) ||
+            !AwaitableTrait<Input>::OnReady(
+                input, Detail::Continuation{&OnInputReady<I>, this}))
+        {
+            Claim(I);
+            return;
+        }
+        if (winner_ != NoWinner)
+        {
+            // Another input fired while this input was registered
+            AwaitableTrait<Input>::Deregister(input);
+            return;
+        }
+        ++registered_;
+    }
+
+    template <std::size_t I>
+    static void OnInputReady(void* self)
+    {
+        auto* const select = static_cast<SelectAwaitable*>(self);
+        if (select->winner_ == NoWinner)
+        {
+            select->Claim(I);
+            if (!select->registering_)
+            {
+                select->waiter_.Notify();
+            }
+        }
+    }
+
+    /// Decides the winner and deregisters all other inputs
+    void Claim(std::size_t winner)
+    {
+        assert(winner_ == NoWinner);
+        winner_ = winner;
+        Deregister(std::index_sequence_for<Awaitables...>{});
+    }
+    /// Removes this operation from all registered inputs
+    void Deregister()
+    {
+        Deregister(std::index_sequence_for<Awaitables...>{});
+        waiter_.Clear();
+    }
+    template <std::size_t... I>
+    void Deregister(std::index_sequence<I...>)
+    {
+        (void)std::initializer_list<int>{
+            ((I < registered_) && (I != winner_)
+                 ? (AwaitableTrait<Awaitables>::Deregister(
+                        std::get<I>(inputs_)),
+                    0)
+                 : 0)...};
+        registered_ = 0;
+    }
+
+    SelectResult<Awaitables...> Unpack()
+    {
+        if (winner_ == NoWinner)
+        {
+            winner_ = FindReady(std::index_sequence_for<Awaitables...>{});
+            assert(winner_ != NoWinner);
+        }
+        return {winner_, std::move(inputs_)};
+    }
+};
+
+template <typename... Awaitables>
+struct AwaitableTrait<SelectAwaitable<Awaitables...>>
+{
+    using Type = SelectAwaitable<Awaitables...>;
+
+    static bool IsReady(Type const& select) { return select.IsReady(); }
+
+    static void Await(Type& select)
+    {
+        if (select.Register(std::index_sequence_for<Awaitables...>{}))
+        {
+            select.waiter_.Suspend();
+        }
+    }
+
+    static SelectResult<Awaitables...> Unpack(Type&& select)
+    {
+        return select.Unpack();
+    }
+
+    static bool OnReady(Type& select, Detail::Continuation next)
+    {
+        select.waiter_.SetContinuation(next);
+        if (select.Register(std::index_sequence_for<Awaitables...>{}))
+        {
+            return true;
+        }
+        select.waiter_.Clear();
+        return false;
+    }
+
+    static void Deregister(Type& select) { select.Deregister(); }
+};
+
+/// Returns an Awaitable which becomes ready as soon as one of the given
+/// Awaitables fires, and which returns a SelectResult. The winning input
+/// can be awaited afterwards to retrieve its result without suspending.
+///
+/// The Awaitables are required to implement AwaitableTrait::OnReady and
+/// AwaitableTrait::Deregister like Futures and Channel operations do.
+template <typename... Awaitables>
+auto Select(Awaitables&&... awaitables)
+{
+    static_assert(sizeof...(Awaitables) > 0,
+                  "Select requires at least one Awaitable!");
+    static_assert(
+        Detail::AllOf<std::is_rvalue_reference<Awaitables&&>::value...>::value,
+        "The awaitables must be passed as r-value reference!");
+
+    return SelectAwaitable<std::decay_t<Awaitables>...>(
+        std::move(awaitables)...);
+}
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_SELECT_HPP_DEFINED
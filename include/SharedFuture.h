@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_SHARED_FUTURE_HPP_DEFINED
+#define TRINITY_ASYNC_SHARED_FUTURE_HPP_DEFINED
+
+#include <cassert>
+#include <tuple>
+#include <utility>
+#include "Awaitable.h"
+#include "Future.h"
+#include "StackListReference.h"
+
+namespace Trinity {
+template <typename... Args>
+class SharedFuture;
+namespace Detail {
+struct SharedFutureAwaitableTraitBase;
+}
+
+/// Represents a single wait operation on a SharedFuture, which is
+/// linked into the waiter list of the SharedFuture while it is awaited.
+///
+/// \attention The SharedFutureAwaitable may not be moved after
+///            it was awaited.
+template <typename... Args>
+class SharedFutureAwaitable
+    : public StackListReference<SharedFutureAwaitable<Args...>>
+{
+    friend SharedFuture<Args...>;
+    friend Detail::SharedFutureAwaitableTraitBase;
+    friend AwaitableTrait<SharedFutureAwaitable>;
+
+    SharedFuture<Args...>* shared_;
+    Detail::Waiter waiter_;
+
+  public:
+    explicit SharedFutureAwaitable(SharedFuture<Args...>& shared) noexcept
+        : shared_(&shared)
+    {
+    }
+
+    /// Returns true when the SharedFuture was resolved
+    bool IsReady() const noexcept { return shared_->IsReady(); }
+};
+
+/// Represents a Future which result can be awaited by many Fibers at once,
+/// where the result is shared between all of them by const reference.
+///
+/// The waiters are linked into an intrusive list which nodes are placed
+/// on the stacks of the waiters, and all of them are continued in one
+/// batch once the SharedFuture is resolved.
+///
+/// \attention The SharedFuture may not be destroyed while it is awaited!
+template <typename... Args>
+class SharedFuture
+{
+    friend Detail::SharedFutureAwaitableTraitBase;
+
+    Future<Args...> future_;
+    StackListReference<SharedFutureAwaitable<Args...>> waiters_;
+    bool registered_ = false;
+
+  public:
+    /// Creates a SharedFuture which is resolved through
+    /// SharedFuture::GetPromise
+    SharedFuture() = default;
+    /// Creates a SharedFuture which is resolved together with
+    /// the given Future.
+    explicit SharedFuture(Future<Args...>&& future)
+        : future_(std::move(future))
+    {
+    }
+    ~SharedFuture()
+    {
+        assert(waiters_.IsEmpty() &&
+               "The SharedFuture was destroyed while it was awaited!");
+    }
+    SharedFuture(SharedFuture const&) = delete;
+    SharedFuture(SharedFuture&&) = delete;
+    SharedFuture& operator=(SharedFuture const&) = delete;
+    SharedFuture& operator=(SharedFuture&&) = delete;
+
+    /// Returns a Promise which is connected to this SharedFuture,
+    /// that can be used to resolve the SharedFuture later.
+    Promise<Args...> GetPromise() noexcept { return future_.GetPromise(); }
+
+    /// Returns true when the SharedFuture was resolved
+    bool IsReady() const noexcept { return future_.IsReady(); }
+
+    /// Returns an Awaitable which becomes ready when this SharedFuture is
+    /// resolved, and which returns the shared result by const reference.
+    /// This can be used from any count of Fibers at the same time.
+    SharedFutureAwaitable<Args...> Wait() noexcept
+    {
+        return SharedFutureAwaitable<Args...>(*this);
+    }
+
+    /// Returns the result values of the resolved SharedFuture
+    std::tuple<Args...> const& Get() const noexcept
+    {
+        assert(IsReady() && "The SharedFuture isn't resolved yet!");
+        return *future_.result_;
+    }
+
+  private:
+    void Register(SharedFutureAwaitable<Args...>& waiter)
+    {
+        assert(!IsReady());
+        waiter.Link(waiters_);
+
+        // The Future is awaited once for all waiters
+        if (!registered_)
+        {
+            registered_ = true;
+            bool const registered = AwaitableTrait<Future<Args...>>::OnReady(
+                future_, Detail::Continuation{&OnResolved, this});
+            assert(registered);
+            (void)registered;
+        }
+    }
+
+    static void OnResolved(void* self)
+    {
+        auto* const shared = static_cast<SharedFuture*>(self);
+
+        // Detach the waiters first, since a continued waiter may destroy
+        // this SharedFuture. Every waiter is unlinked before it is
+        // continued because it destroys its list node afterwards.
+        StackListReference<SharedFutureAwaitable<Args...>> waiters(
+            std::move(shared->waiters_));
+        while (!waiters.IsEmpty())
+        {
+            SharedFutureAwaitable<Args...>* const waiter = waiters.Front();
+            waiter->Unlink();
+            waiter->waiter_.Notify();
+        }
+    }
+};
+
+namespace Detail {
+struct SharedFutureAwaitableTraitBase
+{
+    template <typename T>
+    static bool IsReady(T const& awaitable)
+    {
+        return awaitable.IsReady();
+    }
+
+    template <typename T>
+    static void Await(T& awaitable)
+    {
+        awaitable.shared_->Register(awaitable);
+        awaitable.waiter_.Suspend();
+    }
+
+    template <typename T>
+    static bool OnReady(T& awaitable, Continuation next)
+    {
+        awaitable.waiter_.SetContinuation(next);
+        awaitable.shared_->Register(awaitable);
+        return true;
+    }
+
+    template <typename T>
+    static void Deregister(T& awaitable)
+    {
+        awaitable.Unlink();
+        awaitable.waiter_.Clear();
+    }
+};
+} // namespace Detail
+
+template <>
+struct AwaitableTrait<SharedFutureAwaitable<>>
+    : Detail::SharedFutureAwaitableTraitBase
+{
+    static void Unpack(SharedFutureAwaitable<>&& /*awaitable*/)
+    {
+        // Nothing to do here
+    }
+};
+template <typename Arg>
+struct AwaitableTrait<SharedFutureAwaitable<Arg>>
+    : Detail::SharedFutureAwaitableTraitBase
+{
+    static Arg const& Unpack(SharedFutureAwaitable<Arg>&& awaitable)
+    {
+        return std::get<0>(awaitable.shared_->Get());
+    }
+};
+template <typename FirstArg, typename SecondArg, typename... Args>
+struct AwaitableTrait<SharedFutureAwaitable<FirstArg, SecondArg, Args...>>
+    : Detail::SharedFutureAwaitableTraitBase
+{
+    static std::tuple<FirstArg, SecondArg, Args...> const&
+    Unpack(SharedFutureAwaitable<FirstArg, SecondArg, Args...>&& awaitable)
+    {
+        return awaitable.shared_->Get();
+    }
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_SHARED_FUTURE_HPP_DEFINED
@@ -27,6 +27,8 @@ namespace Trinity {
 /// placed on the stack directly. Elements are of the same type, and the
 /// references are managed automatically upon creation or deletion.
 ///
+/// The list is circular and doubly linked, where the origin of the list
+/// is a plain StackListReference which isn't part of the elements.
 /// The list always grows from left to right.
 ///
 /// \attention This class is threadunsafe and may only be used
@@ -34,80 +36,92 @@ namespace Trinity {
 template <typename Child>
 class StackListReference
 {
-    Child* left_ = nullptr;
-    Child* right_ = nullptr;
+    StackListReference* left_;
+    StackListReference* right_;
 
   public:
     /// Creates a new and empty stack list which origin is this element
-    constexpr StackListReference() = default;
-    /// Adds a new element to the
-    explicit constexpr StackListReference(Child* left) noexcept
-        : left_(GetLastEntryOf(left))
+    constexpr StackListReference() noexcept : left_(this), right_(this) {}
+    /// Adds a new element to the end of the given list
+    explicit StackListReference(StackListReference& list) noexcept
+        : StackListReference()
     {
-        assert(left);
-        assert(left->right_ == nullptr);
-        left->right_ = this;
+        Link(list);
     }
     ~StackListReference() noexcept { Unlink(); }
 
-    explicit constexpr StackListReference(StackListReference const&) = delete;
-    explicit constexpr StackListReference(StackListReference&& right) noexcept
-        : left_(std::exchange(right.left_, nullptr)),
-          right_(std::exchange(right.right_, nullptr))
+    StackListReference(StackListReference const&) = delete;
+    /// Takes the place of the given element inside its list
+    StackListReference(StackListReference&& right) noexcept
+        : StackListReference()
     {
-        /*if (ref_)
-        {
-            ref_->ref_ = static_cast<Child*>(this);
-        }*/
+        Replace(right);
     }
 
-    constexpr StackListReference& operator=(StackListReference const&) = delete;
-    constexpr StackListReference& operator=(StackListReference&& right) noexcept
+    StackListReference& operator=(StackListReference const&) = delete;
+    StackListReference& operator=(StackListReference&& right) noexcept
     {
-        /*Unlink();
-        if ((ref_ = std::exchange(right.ref_, nullptr)))
+        if (this != &right)
         {
-            ref_->ref_ = static_cast<Child*>(this);
-        }*/
+            Unlink();
+            Replace(right);
+        }
         return *this;
     }
 
-  protected:
-    constexpr void Unlink() noexcept
+    /// Adds this element to the end of the given list
+    void Link(StackListReference& list) noexcept
     {
-        /*assert(!right_ || left_);
-        if (left_)
-        {
-            ref_->ref_ = nullptr;
-        }*/
+        assert(!IsLinked() && "The element is linked already!");
+        left_ = list.left_;
+        right_ = &list;
+        left_->right_ = this;
+        list.left_ = this;
     }
 
-    /*constexpr bool HasRef() const noexcept { return bool(ref_); }
-
-    constexpr Child* GetRef() noexcept
+    /// Removes this element from its list
+    void Unlink() noexcept
     {
-        .assert(HasRef());
-         return ref_;
+        left_->right_ = right_;
+        right_->left_ = left_;
+        left_ = this;
+        right_ = this;
     }
-    constexpr Referenced const* GetRef() const noexcept
+
+    /// Returns true when this element is part of a list
+    bool IsLinked() const noexcept { return right_ != this; }
+
+    /// Returns true when the list which origin is this element is empty
+    bool IsEmpty() const noexcept { return !IsLinked(); }
+
+    /// Returns the first element of the list which origin is this element
+    Child* Front() noexcept
     {
-        assert(HasRef());
-        return ref_;
-    }*/
+        assert(!IsEmpty());
+        return static_cast<Child*>(right_);
+    }
 
   private:
-    static constexpr Child* GetLastEntryOf(Child* entry) noexcept
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic push
+// Linking elements which are placed on the stack is intended here,
+// every element unlinks itself from its neighbours on destruction.
+#pragma GCC diagnostic ignored "-Wdangling-pointer"
+#endif
+    void Replace(StackListReference& right) noexcept
     {
-        assert(entry);
-        assert(entry->right_);
-
-        while (entry->right_ != nullptr)
+        if (right.IsLinked())
         {
-            entry = entry->right_;
+            left_ = std::exchange(right.left_, &right);
+            right_ = std::exchange(right.right_, &right);
+            left_->right_ = this;
+            right_->left_ = this;
         }
-        return entry;
     }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic pop
+#endif
 };
 } // namespace Trinity
 
-#endif // TRINITY_ASYNC_STACK_REFERENCE_HPP_DEFINED
+#endif // TRINITY_ASYNC_STACK_LIST_REFERENCE_HPP_DEFINED
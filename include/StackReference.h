@@ -70,6 +70,7 @@ class StackReference
         if (ref_)
         {
             ref_->ref_ = nullptr;
+            ref_ = nullptr;
         }
     }
 
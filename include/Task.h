@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_TASK_HPP_DEFINED
+#define TRINITY_ASYNC_TASK_HPP_DEFINED
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define TC_FIBER_HAS_COROUTINES
+#endif
+#endif
+
+#ifdef TC_FIBER_HAS_COROUTINES
+
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <boost/optional/optional.hpp>
+#include "Awaitable.h"
+#include "Fiber.h"
+#include "Scheduler.h"
+
+namespace Trinity {
+template <typename T = void>
+class Task;
+
+namespace Detail {
+template <typename T>
+struct IsTask : std::false_type
+{
+};
+template <typename T>
+struct IsTask<Task<T>> : std::true_type
+{
+};
+
+template <typename T>
+concept TraitAwaitable = requires(T& awaitable, Continuation next)
+{
+    AwaitableTrait<T>::OnReady(awaitable, next);
+};
+
+/// Resumes a suspended coroutine from the run queue of a Scheduler
+struct CoroutineTask : ScheduledTask
+{
+    std::coroutine_handle<> handle;
+
+    CoroutineTask() noexcept : ScheduledTask(&Run) {}
+
+    static void Run(ScheduledTask* task)
+    {
+        static_cast<CoroutineTask*>(task)->handle.resume();
+    }
+};
+
+/// Awaits an arbitrary Awaitable which implements AwaitableTrait::OnReady
+/// from a Task.
+///
+/// The awaiter is placed inside the coroutine frame, so it removes its
+/// continuation from the awaitable, or from the Scheduler it is queued on,
+/// when the frame is destroyed while the Task is suspended on it.
+template <typename T>
+class TraitAwaiter
+{
+    using Trait = AwaitableTrait<T>;
+
+    T& awaitable_;
+    CoroutineTask task_;
+    /// Is true while the continuation is registered on the awaitable
+    bool registered_ = false;
+
+    static void Resume(void* self)
+    {
+        auto* const awaiter = static_cast<TraitAwaiter*>(self);
+        awaiter->registered_ = false;
+
+        // Queue the Task like a Fiber, such that it isn't resumed
+        // on the stack of the resolver while a Scheduler exists.
+        if (Scheduler* const scheduler = Scheduler::Current())
+        {
+            scheduler->Schedule(&awaiter->task_);
+        }
+        else
+        {
+            awaiter->task_.handle.resume();
+        }
+    }
+
+  public:
+    explicit TraitAwaiter(T& awaitable) noexcept : awaitable_(awaitable) {}
+    ~TraitAwaiter()
+    {
+        if (registered_)
+        {
+            Trait::Deregister(awaitable_);
+        }
+        else if (task_.scheduler)
+        {
+            task_.scheduler->Unschedule(&task_);
+        }
+    }
+    TraitAwaiter(TraitAwaiter const&) = delete;
+    TraitAwaiter& operator=(TraitAwaiter const&) = delete;
+
+    bool await_ready() { return Trait::IsReady(awaitable_); }
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        task_.handle = handle;
+        registered_ = Trait::OnReady(awaitable_, Continuation{&Resume, this});
+        return registered_;
+    }
+    decltype(auto) await_resume() { return Trait::Unpack(std::move(awaitable_)); }
+};
+
+template <typename T>
+class TaskPromiseBase
+{
+    template <typename>
+    friend class Trinity::Task;
+    friend struct AwaitableTrait<Task<T>>;
+
+    /// The coroutine which awaits this Task
+    std::coroutine_handle<> awaiting_;
+    /// Is invoked on completion when the waiter isn't a coroutine
+    Continuation continuation_;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            TaskPromiseBase& promise = handle.promise();
+            if (promise.awaiting_)
+            {
+                return promise.awaiting_;
+            }
+            if (promise.continuation_)
+            {
+                // The continuation may destroy this Task
+                std::exchange(promise.continuation_, {})();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+  public:
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    /// Exceptions may not escape a Task
+    void unhandled_exception() noexcept { std::terminate(); }
+
+    template <typename U>
+    requires(IsTask<std::decay_t<U>>::value) U&& await_transform(U&& task)
+    {
+        return std::forward<U>(task);
+    }
+    template <typename U>
+    requires(!IsTask<std::decay_t<U>>::value &&
+             TraitAwaitable<std::decay_t<U>>) auto await_transform(U&& awaitable)
+    {
+        static_assert(std::is_rvalue_reference<U&&>::value,
+                      "The awaitable must be passed as r-value reference!");
+        return TraitAwaiter<std::decay_t<U>>(awaitable);
+    }
+    template <typename U>
+    requires(!IsTask<std::decay_t<U>>::value &&
+             !TraitAwaitable<std::decay_t<U>>) U&& await_transform(U&& awaitable)
+    {
+        return std::forward<U>(awaitable);
+    }
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase<T>
+{
+    template <typename>
+    friend class Trinity::Task;
+
+    boost::optional<T> result_;
+
+  public:
+    Task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U&& value)
+    {
+        result_.emplace(std::forward<U>(value));
+    }
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase<void>
+{
+  public:
+    Task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+};
+} // namespace Detail
+
+/// Represents a stackless coroutine which resolves to a value of type T,
+/// that can be used for small scripts which don't require a Fiber stack.
+///
+/// The Task starts immediately and may co_await Futures, other Tasks and
+/// every Awaitable whose AwaitableTrait implements OnReady. When such an
+/// Awaitable becomes ready the Task is queued on the Scheduler of the
+/// current thread like a Fiber, or continued directly from the resolver
+/// when the thread has no Scheduler. A Task which awaits another Task
+/// is continued directly when the awaited Task finishes.
+/// A Task itself is awaitable through co_await from other Tasks
+/// and through await from Fibers.
+///
+/// Destroying a Task which isn't finished destroys the coroutine frame
+/// together with the awaitables it owns, and removes its continuation
+/// from the awaitable it is suspended on, such that an awaitable which
+/// outlives the Task never continues it. Awaited Tasks have to outlive
+/// their awaiting Task the same way.
+///
+/// \attention Exceptions may not escape the coroutine of a Task and the
+///            Task is thread unsafe like the Future!
+template <typename T>
+class Task
+{
+  public:
+    using promise_type = Detail::TaskPromise<T>;
+
+  private:
+    friend promise_type;
+    friend struct AwaitableTrait<Task<T>>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Handle handle_;
+
+    explicit Task(Handle handle) noexcept : handle_(handle) {}
+
+  public:
+    Task(Task&& right) noexcept : handle_(std::exchange(right.handle_, {})) {}
+    Task& operator=(Task&& right) noexcept
+    {
+        if (this != &right)
+        {
+            Reset();
+            handle_ = std::exchange(right.handle_, {});
+        }
+        return *this;
+    }
+    Task(Task const&) = delete;
+    Task& operator=(Task const&) = delete;
+    ~Task() { Reset(); }
+
+    /// Returns true when the coroutine of the Task finished
+    bool IsReady() const noexcept
+    {
+        assert(handle_);
+        return handle_.done();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            Handle handle_;
+            /// Is true while the awaiting coroutine is registered on the Task
+            bool suspended_ = false;
+
+            explicit Awaiter(Handle handle) noexcept : handle_(handle) {}
+            ~Awaiter()
+            {
+                // The awaiting coroutine is destroyed while it is suspended
+                if (suspended_)
+                {
+                    handle_.promise().awaiting_ = {};
+                }
+            }
+            Awaiter(Awaiter const&) = delete;
+            Awaiter& operator=(Awaiter const&) = delete;
+
+            bool await_ready() const noexcept { return handle_.done(); }
+            void await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                assert(!handle_.promise().awaiting_ &&
+                       !handle_.promise().continuation_ &&
+                       "The Task is awaited already!");
+                handle_.promise().awaiting_ = awaiting;
+                suspended_ = true;
+            }
+            decltype(auto) await_resume()
+            {
+                suspended_ = false;
+                return Unpack(handle_);
+            }
+        };
+        assert(handle_);
+        return Awaiter{handle_};
+    }
+
+  private:
+    void Reset() noexcept
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+            handle_ = {};
+        }
+    }
+
+    static decltype(auto) Unpack(Handle handle)
+    {
+        assert(handle.done());
+        if constexpr (!std::is_void<T>::value)
+        {
+            return std::move(*handle.promise().result_);
+        }
+    }
+};
+
+namespace Detail {
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+inline Task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(
+        std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+} // namespace Detail
+
+template <typename T>
+struct AwaitableTrait<Task<T>>
+{
+    static bool IsReady(Task<T> const& task) { return task.IsReady(); }
+
+    static void Await(Task<T>& task)
+    {
+        // Removes the continuation when the Fiber is unwound while it waits,
+        // since the Task may outlive the Fiber.
+        struct Guard
+        {
+            Task<T>& task;
+            ~Guard()
+            {
+                if (task.handle_)
+                {
+                    Deregister(task);
+                }
+            }
+        };
+
+        Fiber* const fiber = ThisFiber();
+        OnReady(task, Detail::Continuation{&WakeupFiber, fiber});
+        Guard guard{task};
+        fiber->Suspend();
+    }
+
+    static decltype(auto) Unpack(Task<T>&& task)
+    {
+        return Task<T>::Unpack(task.handle_);
+    }
+
+    static bool OnReady(Task<T>& task, Detail::Continuation next)
+    {
+        auto& promise = task.handle_.promise();
+        assert(!promise.awaiting_ && !promise.continuation_ &&
+               "The Task is awaited already!");
+        assert(!task.IsReady());
+        promise.continuation_ = next;
+        return true;
+    }
+
+    static void Deregister(Task<T>& task)
+    {
+        task.handle_.promise().continuation_ = {};
+    }
+
+  private:
+    static void WakeupFiber(void* fiber)
+    {
+        Wakeup(static_cast<Fiber*>(fiber));
+    }
+};
+} // namespace Trinity
+
+#endif // TC_FIBER_HAS_COROUTINES
+
+#endif // TRINITY_ASYNC_TASK_HPP_DEFINED
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_TASK_QUEUE_HPP_DEFINED
+#define TRINITY_ASYNC_TASK_QUEUE_HPP_DEFINED
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+#include <vector>
+#include "Fiber.h"
+#include "Job.h"
+
+namespace Trinity {
+class FiberPool;
+
+/// Executes short tasks on a small set of long-lived worker Fibers
+/// instead of spawning a Fiber per task.
+///
+/// A worker Fiber runs the queued tasks one after another until the queue
+/// is empty and is parked afterwards, so the Fiber and its context are
+/// reused for all tasks. When a task suspends, its worker stays attached
+/// to the task and the remaining tasks are continued on another worker.
+/// After the suspended task is finished, its worker continues with the
+/// queued tasks and is parked or finished depending on the count of
+/// parked workers.
+///
+/// \attention The TaskQueue is thread unsafe and may not be passed
+///            or used to from multiple threads!
+class TaskQueue
+{
+    FiberPool& pool_;
+    std::size_t const max_idle_;
+    std::deque<Detail::Job> tasks_;
+    /// All workers which are alive, including the ones that are attached
+    /// to a suspended task.
+    std::vector<FiberPtr> workers_;
+    /// The workers which are parked and wait for new tasks
+    std::vector<Fiber*> idle_;
+    std::size_t sweep_threshold_ = 64;
+    std::size_t executed_ = 0;
+    bool running_ = false;
+
+  public:
+    /// Creates a TaskQueue which spawns its workers from the given pool
+    /// and keeps at most max_idle workers parked.
+    explicit TaskQueue(FiberPool& pool, std::size_t max_idle = 4);
+    /// Cancels all workers and drops the tasks which weren't executed
+    ~TaskQueue();
+    TaskQueue(TaskQueue const&) = delete;
+    TaskQueue(TaskQueue&&) = delete;
+    TaskQueue& operator=(TaskQueue const&) = delete;
+    TaskQueue& operator=(TaskQueue&&) = delete;
+
+    /// Queues the given callable, that must accept the signature of `void()`.
+    /// The callable is executed on the next call to TaskQueue::Run,
+    /// or by the current worker when it is posted from a task.
+    template <typename Callable>
+    void Post(Callable&& callable)
+    {
+        tasks_.emplace_back(std::forward<Callable>(callable));
+    }
+
+    /// Executes all queued tasks, including the ones which were posted
+    /// while running, until every task finished or suspended.
+    /// Returns the count of tasks which were finished, including the tasks
+    /// which suspended during an earlier call and finished since.
+    std::size_t Run();
+
+    /// Returns the count of queued tasks
+    std::size_t Size() const noexcept { return tasks_.size(); }
+
+    /// Returns true when no task is queued
+    bool IsEmpty() const noexcept { return tasks_.empty(); }
+
+    /// Returns the count of worker Fibers which are alive
+    std::size_t Workers() const noexcept { return workers_.size(); }
+
+  private:
+    Fiber* SpawnWorker();
+    void Work();
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_TASK_QUEUE_HPP_DEFINED
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_TIMER_WHEEL_HPP_DEFINED
+#define TRINITY_ASYNC_TIMER_WHEEL_HPP_DEFINED
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/optional/optional.hpp>
+#include "Future.h"
+
+namespace Trinity {
+/// Identifies a timer which was scheduled on a TimerWheel
+class TimerId
+{
+    friend class TimerWheel;
+
+    std::uint32_t index_ = 0;
+    std::uint32_t generation_ = 0;
+
+    explicit constexpr TimerId(std::uint32_t index,
+                               std::uint32_t generation) noexcept
+        : index_(index), generation_(generation)
+    {
+    }
+
+  public:
+    constexpr TimerId() noexcept = default;
+
+    /// Returns true when the TimerId refers to a scheduled timer
+    explicit constexpr operator bool() const noexcept
+    {
+        return generation_ != 0;
+    }
+};
+
+/// A hierarchical timing wheel which resolves Futures when their
+/// deadline has passed.
+///
+/// The wheel doesn't query any clock itself, instead the time is driven
+/// explicitly through TimerWheel::Advance, usually from the world tick.
+/// Scheduling and canceling a timer is O(1) independent of the count of
+/// pending timers, the timers are stored in a recycled node array.
+///
+/// \attention The TimerWheel is thread unsafe and may not be passed
+///            or used to from multiple threads!
+class TimerWheel
+{
+  public:
+    using Duration = std::chrono::milliseconds;
+    /// The time since an arbitrary epoch which is chosen by the owner
+    using TimePoint = std::chrono::milliseconds;
+
+  private:
+    static constexpr std::size_t SlotBits = 6;
+    static constexpr std::size_t Slots = std::size_t(1) << SlotBits;
+    static constexpr std::size_t Levels = 6;
+    static constexpr std::uint32_t Invalid = ~std::uint32_t(0);
+    /// The slot index of timers which don't fit into the wheel
+    static constexpr std::uint32_t Overflow = Levels * Slots;
+
+    struct Node
+    {
+        std::int64_t deadline = 0;
+        std::uint32_t next = Invalid;
+        std::uint32_t prev = Invalid;
+        std::uint32_t slot = Invalid;
+        std::uint32_t generation = 1;
+        boost::optional<Promise<>> promise;
+    };
+
+    std::int64_t now_;
+    std::size_t size_ = 0;
+    std::vector<Node> nodes_;
+    std::uint32_t free_ = Invalid;
+    std::array<std::uint32_t, Levels * Slots + 1> heads_;
+    std::array<std::uint64_t, Levels> occupied_{};
+    std::vector<Promise<>> expired_;
+
+  public:
+    explicit TimerWheel(TimePoint now = TimePoint::zero());
+    ~TimerWheel();
+    TimerWheel(TimerWheel const&) = delete;
+    TimerWheel(TimerWheel&&) = delete;
+    TimerWheel& operator=(TimerWheel const&) = delete;
+    TimerWheel& operator=(TimerWheel&&) = delete;
+
+    /// Returns a Future which is resolved after the given duration passed
+    Future<> Wait(Duration duration) { return WaitUntil(Now() + duration); }
+
+    /// Returns a Future which is resolved when the given deadline passed
+    Future<> WaitUntil(TimePoint deadline);
+
+    /// Schedules the given Promise to be resolved when the deadline passed
+    TimerId Schedule(TimePoint deadline, Promise<> promise);
+
+    /// Removes the timer with the given id from the wheel without
+    /// resolving its Promise. Returns false when the timer fired already.
+    ///
+    /// \attention The Future of the timer is never resolved afterwards,
+    ///            thus canceling is only valid after the Future was dropped.
+    bool Cancel(TimerId id);
+
+    /// Advances the time of the wheel to the given time point and resolves
+    /// the Promises of all timers which deadline has passed.
+    /// Returns the count of resolved timers.
+    std::size_t Advance(TimePoint now);
+
+    /// Returns the current time of the wheel
+    TimePoint Now() const noexcept { return TimePoint(now_); }
+
+    /// Returns the count of pending timers
+    std::size_t Size() const noexcept { return size_; }
+
+  private:
+    std::uint32_t Allocate();
+    void Free(std::uint32_t index);
+    void Link(std::uint32_t index);
+    void Unlink(std::uint32_t index);
+    void Expire(std::uint32_t index);
+    void Cascade(std::uint32_t slot);
+    std::int64_t NextEvent() const noexcept;
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_TIMER_WHEEL_HPP_DEFINED
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_WAIT_QUEUE_HPP_DEFINED
+#define TRINITY_ASYNC_WAIT_QUEUE_HPP_DEFINED
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include "Fiber.h"
+#include "Scheduler.h"
+#include "StackListReference.h"
+
+namespace Trinity {
+namespace Detail {
+/// A FIFO queue of suspended Fibers which is used by the Fiber aware
+/// synchronization primitives. The nodes of the queue are placed on the
+/// stacks of the waiting Fibers, thus waiting never allocates.
+///
+/// \attention This class is threadunsafe and may only be used
+///            from the same thread!
+class WaitQueue
+{
+    struct Node : StackListReference<Node>
+    {
+        WeakFiberPtr fiber;
+        bool woken = false;
+    };
+
+    StackListReference<Node> nodes_;
+
+  public:
+    WaitQueue() = default;
+    ~WaitQueue()
+    {
+        assert(nodes_.IsEmpty() &&
+               "The WaitQueue was destroyed while Fibers are waiting!");
+    }
+    WaitQueue(WaitQueue const&) = delete;
+    WaitQueue(WaitQueue&&) = delete;
+    WaitQueue& operator=(WaitQueue const&) = delete;
+    WaitQueue& operator=(WaitQueue&&) = delete;
+
+    /// Returns true when no Fiber is waiting
+    bool IsEmpty() const noexcept { return nodes_.IsEmpty(); }
+
+    /// Suspends the current Fiber until it is woken through WakeOne
+    /// or WakeAll. When the Fiber is canceled after it was woken but
+    /// before it continued, the given callable is invoked to pass on
+    /// whatever was granted to the Fiber.
+    template <typename Abandon>
+    void Wait(Abandon&& abandon)
+    {
+        struct Guard
+        {
+            Node& node;
+            Abandon& abandon;
+            bool continued;
+            ~Guard()
+            {
+                if (!continued && node.woken)
+                {
+                    abandon();
+                }
+            }
+        };
+
+        Fiber* const fiber = ThisFiber();
+        Node node;
+        node.fiber = WeakFiberPtr(fiber);
+        node.Link(nodes_);
+
+        Guard guard{node, abandon, false};
+        fiber->Suspend();
+        assert(node.woken && "The Fiber was resumed while it was waiting!");
+        guard.continued = true;
+    }
+
+    /// Wakes the Fiber which is waiting the longest.
+    /// Returns false when no Fiber is waiting.
+    bool WakeOne()
+    {
+        if (nodes_.IsEmpty())
+        {
+            return false;
+        }
+
+        Node* const node = nodes_.Front();
+        node->Unlink();
+        node->woken = true;
+        Wakeup(node->fiber.Get());
+        return true;
+    }
+
+    /// Wakes all waiting Fibers, and returns their count
+    std::size_t WakeAll()
+    {
+        // Detach the nodes first, since a woken Fiber may destroy
+        // the owner of this queue.
+        StackListReference<Node> nodes(std::move(nodes_));
+        std::size_t count = 0;
+        while (!nodes.IsEmpty())
+        {
+            Node* const node = nodes.Front();
+            node->Unlink();
+            node->woken = true;
+            Wakeup(node->fiber.Get());
+            ++count;
+        }
+        return count;
+    }
+};
+} // namespace Detail
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_WAIT_QUEUE_HPP_DEFINED
@@ -18,13 +18,334 @@
 #ifndef TRINITY_WHEN_ALL_HPP_DEFINED
 #define TRINITY_WHEN_ALL_HPP_DEFINED
 
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "Awaitable.h"
 #include "Future.h"
 
 namespace Trinity {
-template <typename T>
-auto WhenAll(T&&... futures)
+namespace Detail {
+template <bool... Values>
+using AllOf = std::is_same<std::integer_sequence<bool, true, Values...>,
+                           std::integer_sequence<bool, Values..., true>>;
+
+/// Returns the result values of the given ready Awaitable,
+/// where Awaitables without result values are mapped to an empty tuple.
+template <typename T,
+          typename Result = decltype(AwaitableTrait<std::decay_t<T>>::Unpack(
+              std::declval<T>())),
+          std::enable_if_t<!std::is_void<Result>::value>* = nullptr>
+Result UnpackValue(T&& awaitable)
+{
+    return AwaitableTrait<std::decay_t<T>>::Unpack(std::forward<T>(awaitable));
+}
+template <typename T,
+          typename Result = decltype(AwaitableTrait<std::decay_t<T>>::Unpack(
+              std::declval<T>())),
+          std::enable_if_t<std::is_void<Result>::value>* = nullptr>
+std::tuple<> UnpackValue(T&& awaitable)
+{
+    AwaitableTrait<std::decay_t<T>>::Unpack(std::forward<T>(awaitable));
+    return {};
+}
+} // namespace Detail
+
+/// Represents the combination of multiple Awaitables, which becomes ready
+/// when all of them are resolved and returns their result values as tuple.
+///
+/// The state of the combinator is stored inline together with its inputs,
+/// the waiter is continued once after the last input was resolved.
+///
+/// \attention The WhenAllAwaitable may not be moved after it was awaited.
+template <typename... Awaitables>
+class WhenAllAwaitable
+{
+    friend AwaitableTrait<WhenAllAwaitable>;
+
+    std::tuple<Awaitables...> inputs_;
+    std::size_t pending_ = 0;
+    Detail::Waiter waiter_;
+
+  public:
+    explicit WhenAllAwaitable(Awaitables&&... inputs)
+        : inputs_(std::move(inputs)...)
+    {
+    }
+    WhenAllAwaitable(WhenAllAwaitable&&) = default;
+    WhenAllAwaitable& operator=(WhenAllAwaitable&&) = default;
+    /// Removes this combinator from the pending inputs,
+    /// in case the waiter was unwound before they were resolved.
+    ~WhenAllAwaitable() { Deregister(); }
+
+    /// Returns true when all inputs are resolved
+    bool IsReady() const
+    {
+        return IsReady(std::index_sequence_for<Awaitables...>{});
+    }
+
+  private:
+    template <std::size_t... I>
+    bool IsReady(std::index_sequence<I...>) const
+    {
+        bool ready = true;
+        (void)std::initializer_list<int>{
+            (ready = ready && AwaitableTrait<Awaitables>::IsReady(
+                                  std::get<I>(inputs_)),
+             0)...};
+        return ready;
+    }
+
+    /// Registers this combinator on all pending inputs.
+    /// Returns false when all inputs became ready during the registration.
+    template <std::size_t... I>
+    bool Register(std::index_sequence<I...>)
+    {
+        assert(pending_ == 0 && "The WhenAllAwaitable is awaited already!");
+
+        // The registration itself counts as pending input, so the waiter
+        // isn't notified before all inputs were registered.
+        pending_ = 1;
+        (void)std::initializer_list<int>{(Register(std::get<I>(inputs_)), 0)...};
+        return --pending_ > 0;
+    }
+    template <typename T>
+    void Register(T& input)
+    {
+        if (!AwaitableTrait<T>::IsReady(input) &&
+            AwaitableTrait<T>::OnReady(
+                input, Detail::Continuation{&OnInputReady, this}))
+        {
+            ++pending_;
+        }
+    }
+
+    /// Removes this combinator from all inputs which are still pending
+    void Deregister()
+    {
+        if (pending_ > 0)
+        {
+            Deregister(std::index_sequence_for<Awaitables...>{});
+            pending_ = 0;
+        }
+        waiter_.Clear();
+    }
+    template <std::size_t... I>
+    void Deregister(std::index_sequence<I...>)
+    {
+        (void)std::initializer_list<int>{(Deregister(std::get<I>(inputs_)), 0)...};
+    }
+    template <typename T>
+    void Deregister(T& input)
+    {
+        if (!AwaitableTrait<T>::IsReady(input))
+        {
+            AwaitableTrait<T>::Deregister(input);
+        }
+    }
+
+    static void OnInputReady(void* self)
+    {
+        auto* const all = static_cast<WhenAllAwaitable*>(self);
+        assert(all->pending_ > 0);
+        if (--all->pending_ == 0)
+        {
+            all->waiter_.Notify();
+        }
+    }
+
+    template <std::size_t... I>
+    auto Unpack(std::index_sequence<I...>)
+    {
+        return std::make_tuple(
+            Detail::UnpackValue(std::move(std::get<I>(inputs_)))...);
+    }
+};
+
+/// Represents the combination of a range of Awaitables, which becomes ready
+/// when all of them are resolved. The result values stay inside the range.
+///
+/// \attention The range has to outlive the combinator and may not
+///            be modified while it is awaited.
+template <typename Range>
+class WhenAllRangeAwaitable
+{
+    friend AwaitableTrait<WhenAllRangeAwaitable>;
+
+    using Input = std::decay_t<decltype(*std::begin(std::declval<Range&>()))>;
+
+    Range* range_;
+    std::size_t pending_ = 0;
+    Detail::Waiter waiter_;
+
+  public:
+    explicit WhenAllRangeAwaitable(Range& range) : range_(&range) {}
+    WhenAllRangeAwaitable(WhenAllRangeAwaitable&&) = default;
+    WhenAllRangeAwaitable& operator=(WhenAllRangeAwaitable&&) = default;
+    /// Removes this combinator from the pending inputs,
+    /// in case the waiter was unwound before they were resolved.
+    ~WhenAllRangeAwaitable() { Deregister(); }
+
+    /// Returns true when all inputs are resolved
+    bool IsReady() const
+    {
+        for (auto const& input : *range_)
+        {
+            if (!AwaitableTrait<Input>::IsReady(input))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+  private:
+    /// Registers this combinator on all pending inputs.
+    /// Returns false when all inputs became ready during the registration.
+    bool Register()
+    {
+        assert(pending_ == 0 && "The WhenAllAwaitable is awaited already!");
+
+        // The registration itself counts as pending input, so the waiter
+        // isn't notified before all inputs were registered.
+        pending_ = 1;
+        for (auto& input : *range_)
+        {
+            if (!AwaitableTrait<Input>::IsReady(input) &&
+                AwaitableTrait<Input>::OnReady(
+                    input, Detail::Continuation{&OnInputReady, this}))
+            {
+                ++pending_;
+            }
+        }
+        return --pending_ > 0;
+    }
+
+    /// Removes this combinator from all inputs which are still pending
+    void Deregister()
+    {
+        if (pending_ > 0)
+        {
+            for (auto& input : *range_)
+            {
+                if (!AwaitableTrait<Input>::IsReady(input))
+                {
+                    AwaitableTrait<Input>::Deregister(input);
+                }
+            }
+            pending_ = 0;
+        }
+        waiter_.Clear();
+    }
+
+    static void OnInputReady(void* self)
+    {
+        auto* const all = static_cast<WhenAllRangeAwaitable*>(self);
+        assert(all->pending_ > 0);
+        if (--all->pending_ == 0)
+        {
+            all->waiter_.Notify();
+        }
+    }
+};
+
+template <typename... Awaitables>
+struct AwaitableTrait<WhenAllAwaitable<Awaitables...>>
+{
+    using Type = WhenAllAwaitable<Awaitables...>;
+
+    static bool IsReady(Type const& all) { return all.IsReady(); }
+
+    static void Await(Type& all)
+    {
+        if (all.Register(std::index_sequence_for<Awaitables...>{}))
+        {
+            all.waiter_.Suspend();
+        }
+    }
+
+    static auto Unpack(Type&& all)
+    {
+        return all.Unpack(std::index_sequence_for<Awaitables...>{});
+    }
+
+    static bool OnReady(Type& all, Detail::Continuation next)
+    {
+        all.waiter_.SetContinuation(next);
+        if (all.Register(std::index_sequence_for<Awaitables...>{}))
+        {
+            return true;
+        }
+        all.waiter_.Clear();
+        return false;
+    }
+
+    static void Deregister(Type& all) { all.Deregister(); }
+};
+
+template <typename Range>
+struct AwaitableTrait<WhenAllRangeAwaitable<Range>>
+{
+    using Type = WhenAllRangeAwaitable<Range>;
+
+    static bool IsReady(Type const& all) { return all.IsReady(); }
+
+    static void Await(Type& all)
+    {
+        if (all.Register())
+        {
+            all.waiter_.Suspend();
+        }
+    }
+
+    static void Unpack(Type&& /*all*/)
+    {
+        // The results are left inside the range
+    }
+
+    static bool OnReady(Type& all, Detail::Continuation next)
+    {
+        all.waiter_.SetContinuation(next);
+        if (all.Register())
+        {
+            return true;
+        }
+        all.waiter_.Clear();
+        return false;
+    }
+
+    static void Deregister(Type& all) { all.Deregister(); }
+};
+
+/// Returns an Awaitable which becomes ready when all given Awaitables
+/// are resolved, and which returns a tuple of their result values.
+///
+/// The Awaitables are required to implement AwaitableTrait::OnReady
+/// like Futures do.
+template <typename... Awaitables>
+auto WhenAll(Awaitables&&... awaitables)
+{
+    static_assert(sizeof...(Awaitables) > 0,
+                  "WhenAll requires at least one Awaitable!");
+    static_assert(
+        Detail::AllOf<std::is_rvalue_reference<Awaitables&&>::value...>::value,
+        "The awaitables must be passed as r-value reference!");
+
+    return WhenAllAwaitable<std::decay_t<Awaitables>...>(
+        std::move(awaitables)...);
+}
+
+/// Returns an Awaitable which becomes ready when all Awaitables inside
+/// the given range are resolved, the results are left inside the range.
+template <typename Range,
+          typename = decltype(std::begin(std::declval<Range&>()))>
+auto WhenAll(Range& range)
 {
-    return MakeReadyFuture();
+    return WhenAllRangeAwaitable<Range>(range);
 }
 } // namespace Trinity
 
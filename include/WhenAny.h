@@ -18,13 +18,428 @@
 #ifndef TRINITY_WHEN_ANY_HPP_DEFINED
 #define TRINITY_WHEN_ANY_HPP_DEFINED
 
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "Awaitable.h"
 #include "Future.h"
+#include "WhenAll.h"
 
 namespace Trinity {
+namespace Detail {
+/// Cancels the given Awaitable if it supports it
 template <typename T>
-auto WhenAny(T&&... futures)
+auto CancelInput(T& input, int) -> decltype(input.Cancel(), void())
 {
-    return MakeReadyFuture();
+    input.Cancel();
+}
+template <typename T>
+void CancelInput(T& /*input*/, long)
+{
+}
+
+constexpr std::size_t NoWinner = std::numeric_limits<std::size_t>::max();
+} // namespace Detail
+
+/// The result of WhenAny, which contains the index of the first resolved
+/// input together with all inputs, where the winning input is ready and the
+/// other inputs are deregistered and canceled.
+template <typename... Awaitables>
+struct WhenAnyResult
+{
+    std::size_t index;
+    std::tuple<Awaitables...> inputs;
+};
+
+/// Represents the combination of multiple Awaitables, which becomes ready
+/// as soon as one of them is resolved.
+///
+/// All other inputs are deregistered and canceled when the first input is
+/// resolved, for Futures this releases their resolving Fibers which are
+/// canceled and recycled when there is no other reference to them.
+///
+/// \attention The WhenAnyAwaitable may not be moved after it was awaited.
+template <typename... Awaitables>
+class WhenAnyAwaitable
+{
+    friend AwaitableTrait<WhenAnyAwaitable>;
+
+    std::tuple<Awaitables...> inputs_;
+    std::size_t winner_ = Detail::NoWinner;
+    /// The count of leading inputs which were registered
+    std::size_t registered_ = 0;
+    /// Is true while the inputs are registered
+    bool registering_ = false;
+    Detail::Waiter waiter_;
+
+  public:
+    explicit WhenAnyAwaitable(Awaitables&&... inputs)
+        : inputs_(std::move(inputs)...)
+    {
+    }
+    WhenAnyAwaitable(WhenAnyAwaitable&&) = default;
+    WhenAnyAwaitable& operator=(WhenAnyAwaitable&&) = default;
+    /// Removes this combinator from the registered inputs,
+    /// in case the waiter was unwound before any input was resolved.
+    ~WhenAnyAwaitable() { Deregister(); }
+
+    /// Returns true when any input is resolved
+    bool IsReady() const
+    {
+        return (winner_ != Detail::NoWinner) ||
+               (FindReady(std::index_sequence_for<Awaitables...>{}) !=
+                Detail::NoWinner);
+    }
+
+  private:
+    template <std::size_t... I>
+    std::size_t FindReady(std::index_sequence<I...>) const
+    {
+        std::size_t ready = Detail::NoWinner;
+        (void)std::initializer_list<int>{
+            ((ready == Detail::NoWinner) &&
+                     AwaitableTrait<Awaitables>::IsReady(std::get<I>(inputs_))
+                 ? (ready = I, 0)
+                 : 0)...};
+        return ready;
+    }
+
+    /// Decides the winner, and deregisters and cancels all other inputs
+    template <std::size_t... I>
+    void Select(std::index_sequence<I...> sequence)
+    {
+        assert(winner_ == Detail::NoWinner);
+        winner_ = FindReady(sequence);
+        assert(winner_ != Detail::NoWinner);
+
+        (void)std::initializer_list<int>{
+            ((I != winner_)
+                 ? (Release(std::get<I>(inputs_), I < registered_), 0)
+                 : 0)...};
+        registered_ = 0;
+    }
+    template <typename T>
+    static void Release(T& input, bool registered)
+    {
+        if (registered)
+        {
+            AwaitableTrait<T>::Deregister(input);
+        }
+        Detail::CancelInput(input, 0);
+    }
+
+    /// Removes this combinator from all registered inputs
+    void Deregister()
+    {
+        if (registered_ > 0)
+        {
+            Deregister(std::index_sequence_for<Awaitables...>{});
+            registered_ = 0;
+        }
+        waiter_.Clear();
+    }
+    template <std::size_t... I>
+    void Deregister(std::index_sequence<I...>)
+    {
+        (void)std::initializer_list<int>{
+            ((I < registered_) ? (AwaitableTrait<Awaitables>::Deregister(
+                                      std::get<I>(inputs_)),
+                                  0)
+                               : 0)...};
+    }
+
+    /// Registers this combinator on the inputs until one of them is ready.
+    /// Returns false when the winner was decided during the registration.
+    template <std::size_t... I>
+    bool Register(std::index_sequence<I...>)
+    {
+        // The waiter isn't notified before all inputs were registered
+        registering_ = true;
+        (void)std::initializer_list<int>{(Register(std::get<I>(inputs_)), 0)...};
+        registering_ = false;
+        return winner_ == Detail::NoWinner;
+    }
+    template <typename T>
+    void Register(T& input)
+    {
+        if (winner_ != Detail::NoWinner)
+        {
+            return;
+        }
+        if (AwaitableTrait<T>::IsReady(input) ||
+            !AwaitableTrait<T>::OnReady(
+                input, Detail::Continuation{&OnInputReady, this}))
+        {
+            Select(std::index_sequence_for<Awaitables...>{});
+            return;
+        }
+        if (winner_ != Detail::NoWinner)
+        {
+            // Another input was resolved while this input was registered
+            AwaitableTrait<T>::Deregister(input);
+            return;
+        }
+        ++registered_;
+    }
+
+    static void OnInputReady(void* self)
+    {
+        auto* const any = static_cast<WhenAnyAwaitable*>(self);
+        any->Select(std::index_sequence_for<Awaitables...>{});
+        if (!any->registering_)
+        {
+            any->waiter_.Notify();
+        }
+    }
+
+    WhenAnyResult<Awaitables...> Unpack()
+    {
+        if (winner_ == Detail::NoWinner)
+        {
+            Select(std::index_sequence_for<Awaitables...>{});
+        }
+        return {winner_, std::move(inputs_)};
+    }
+};
+
+/// Represents the combination of a range of Awaitables, which becomes ready
+/// as soon as one of them is resolved, and returns the index and the result
+/// of the first resolved input. All other inputs are canceled.
+///
+/// \attention The range has to outlive the combinator and may not
+///            be modified while it is awaited.
+template <typename Range>
+class WhenAnyRangeAwaitable
+{
+    friend AwaitableTrait<WhenAnyRangeAwaitable>;
+
+    using Input = std::decay_t<decltype(*std::begin(std::declval<Range&>()))>;
+
+    Range* range_;
+    std::size_t winner_ = Detail::NoWinner;
+    /// The count of leading inputs which were registered
+    std::size_t registered_ = 0;
+    /// Is true while the inputs are registered
+    bool registering_ = false;
+    Detail::Waiter waiter_;
+
+  public:
+    explicit WhenAnyRangeAwaitable(Range& range) : range_(&range) {}
+    WhenAnyRangeAwaitable(WhenAnyRangeAwaitable&&) = default;
+    WhenAnyRangeAwaitable& operator=(WhenAnyRangeAwaitable&&) = default;
+    /// Removes this combinator from the registered inputs,
+    /// in case the waiter was unwound before any input was resolved.
+    ~WhenAnyRangeAwaitable() { Deregister(); }
+
+    /// Returns true when any input is resolved
+    bool IsReady() const
+    {
+        return (winner_ != Detail::NoWinner) ||
+               (FindReady() != Detail::NoWinner);
+    }
+
+  private:
+    std::size_t FindReady() const
+    {
+        std::size_t index = 0;
+        for (auto const& input : *range_)
+        {
+            if (AwaitableTrait<Input>::IsReady(input))
+            {
+                return index;
+            }
+            ++index;
+        }
+        return Detail::NoWinner;
+    }
+
+    void Select()
+    {
+        assert(winner_ == Detail::NoWinner);
+        winner_ = FindReady();
+        assert(winner_ != Detail::NoWinner);
+
+        std::size_t index = 0;
+        for (auto& input : *range_)
+        {
+            if (index != winner_)
+            {
+                if (index < registered_)
+                {
+                    AwaitableTrait<Input>::Deregister(input);
+                }
+                Detail::CancelInput(input, 0);
+            }
+            ++index;
+        }
+        registered_ = 0;
+    }
+
+    /// Removes this combinator from all registered inputs
+    void Deregister()
+    {
+        std::size_t index = 0;
+        for (auto& input : *range_)
+        {
+            if (index++ >= registered_)
+            {
+                break;
+            }
+            AwaitableTrait<Input>::Deregister(input);
+        }
+        registered_ = 0;
+        waiter_.Clear();
+    }
+
+    /// Registers this combinator on the inputs until one of them is ready.
+    /// Returns false when the winner was decided during the registration.
+    bool Register()
+    {
+        // The waiter isn't notified before all inputs were registered
+        registering_ = true;
+        for (auto& input : *range_)
+        {
+            if (winner_ != Detail::NoWinner)
+            {
+                break;
+            }
+            if (AwaitableTrait<Input>::IsReady(input) ||
+                !AwaitableTrait<Input>::OnReady(
+                    input, Detail::Continuation{&OnInputReady, this}))
+            {
+                Select();
+            }
+            else if (winner_ != Detail::NoWinner)
+            {
+                // Another input was resolved while this input was registered
+                AwaitableTrait<Input>::Deregister(input);
+            }
+            else
+            {
+                ++registered_;
+            }
+        }
+        registering_ = false;
+        return winner_ == Detail::NoWinner;
+    }
+
+    static void OnInputReady(void* self)
+    {
+        auto* const any = static_cast<WhenAnyRangeAwaitable*>(self);
+        any->Select();
+        if (!any->registering_)
+        {
+            any->waiter_.Notify();
+        }
+    }
+
+    auto Unpack()
+    {
+        if (winner_ == Detail::NoWinner)
+        {
+            Select();
+        }
+        auto winner = std::begin(*range_);
+        std::advance(winner, winner_);
+        return std::make_pair(winner_, Detail::UnpackValue(std::move(*winner)));
+    }
+};
+
+template <typename... Awaitables>
+struct AwaitableTrait<WhenAnyAwaitable<Awaitables...>>
+{
+    using Type = WhenAnyAwaitable<Awaitables...>;
+
+    static bool IsReady(Type const& any) { return any.IsReady(); }
+
+    static void Await(Type& any)
+    {
+        if (any.Register(std::index_sequence_for<Awaitables...>{}))
+        {
+            any.waiter_.Suspend();
+        }
+    }
+
+    static WhenAnyResult<Awaitables...> Unpack(Type&& any)
+    {
+        return any.Unpack();
+    }
+
+    static bool OnReady(Type& any, Detail::Continuation next)
+    {
+        any.waiter_.SetContinuation(next);
+        if (any.Register(std::index_sequence_for<Awaitables...>{}))
+        {
+            return true;
+        }
+        any.waiter_.Clear();
+        return false;
+    }
+
+    static void Deregister(Type& any) { any.Deregister(); }
+};
+
+template <typename Range>
+struct AwaitableTrait<WhenAnyRangeAwaitable<Range>>
+{
+    using Type = WhenAnyRangeAwaitable<Range>;
+
+    static bool IsReady(Type const& any) { return any.IsReady(); }
+
+    static void Await(Type& any)
+    {
+        if (any.Register())
+        {
+            any.waiter_.Suspend();
+        }
+    }
+
+    static auto Unpack(Type&& any) { return any.Unpack(); }
+
+    static bool OnReady(Type& any, Detail::Continuation next)
+    {
+        any.waiter_.SetContinuation(next);
+        if (any.Register())
+        {
+            return true;
+        }
+        any.waiter_.Clear();
+        return false;
+    }
+
+    static void Deregister(Type& any) { any.Deregister(); }
+};
+
+/// Returns an Awaitable which becomes ready as soon as one of the given
+/// Awaitables is resolved, and which returns a WhenAnyResult.
+/// The other Awaitables are canceled, which drops the resolving Fibers
+/// of Futures whose result isn't needed anymore.
+template <typename... Awaitables>
+auto WhenAny(Awaitables&&... awaitables)
+{
+    static_assert(sizeof...(Awaitables) > 0,
+                  "WhenAny requires at least one Awaitable!");
+    static_assert(
+        Detail::AllOf<std::is_rvalue_reference<Awaitables&&>::value...>::value,
+        "The awaitables must be passed as r-value reference!");
+
+    return WhenAnyAwaitable<std::decay_t<Awaitables>...>(
+        std::move(awaitables)...);
+}
+
+/// Returns an Awaitable which becomes ready as soon as one of the
+/// Awaitables inside the given range is resolved, and which returns
+/// the index and the result values of that Awaitable.
+template <typename Range,
+          typename = decltype(std::begin(std::declval<Range&>()))>
+auto WhenAny(Range& range)
+{
+    return WhenAnyRangeAwaitable<Range>(range);
 }
 } // namespace Trinity
 
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_ASYNC_WORKER_POOL_HPP_DEFINED
+#define TRINITY_ASYNC_WORKER_POOL_HPP_DEFINED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "Job.h"
+
+namespace Trinity {
+/// Executes work on a fixed set of worker threads, where every worker
+/// owns its own FiberPool, Scheduler and a local run queue.
+/// Fibers which became ready are continued before new jobs are started.
+///
+/// Work which is posted from inside a worker is queued on the local run
+/// queue of that worker, otherwise it is distributed across all workers.
+/// Idle workers steal queued work from the run queues of busy workers.
+///
+/// Since Fibers may not be passed to other threads, work is stolen before
+/// it is started. After a worker started the Fiber of a job, the Fiber
+/// stays on the worker thread until it is finished and is recycled
+/// into the FiberPool of that worker.
+///
+/// The count of Fibers per worker can be limited, in which case a worker
+/// stops taking new jobs while its FiberPool is exhausted, so the jobs
+/// stay queued for other workers instead of growing the memory usage
+/// without bound.
+///
+/// A sleeping worker is woken up when a task is posted to its Scheduler
+/// from another thread, so a job may await a RemoteFuture.
+///
+/// \attention The WorkerPool itself is threadsafe, however all Fibers,
+///            Futures and Promises used by a job are bound to the worker
+///            which executes the job!
+class WorkerPool
+{
+    struct Worker;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<std::size_t> sleeping_{0};
+    std::atomic<std::size_t> next_{0};
+    std::atomic<bool> stopping_{false};
+    std::size_t const max_fibers_;
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_;
+    /// Is waited on by workers which can't take jobs because their
+    /// FiberPool is exhausted.
+    std::condition_variable parked_;
+
+  public:
+    /// Starts the given count of worker threads, where each worker keeps
+    /// at most max_fibers Fibers alive at the same time,
+    /// zero means that the count is unlimited.
+    explicit WorkerPool(std::size_t workers = DefaultWorkerCount(),
+                        std::size_t max_fibers = 0);
+    /// Runs all queued jobs, cancels the Fibers which are still suspended
+    /// afterwards and joins all worker threads.
+    ~WorkerPool();
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool&&) = delete;
+
+    /// Queues the given callable, that must accept the signature of `void()`,
+    /// for execution inside a Fiber on one of the workers.
+    ///
+    /// \attention This method is threadsafe.
+    template <typename Callable>
+    void Post(Callable&& callable)
+    {
+        Enqueue(Detail::Job(std::forward<Callable>(callable)));
+    }
+
+    /// Returns the count of worker threads
+    std::size_t Size() const noexcept { return workers_.size(); }
+
+    /// Returns the count of worker threads which is used by default
+    static std::size_t DefaultWorkerCount() noexcept;
+
+  private:
+    static Worker*& ThisWorker() noexcept;
+    void Enqueue(Detail::Job job);
+    void Run(Worker& worker);
+    bool Pop(Worker& worker, Detail::Job& job);
+    bool Steal(Worker& thief, Detail::Job& job);
+    void Sleep(Worker& worker);
+    void Park(Worker& worker);
+    static void OnRemoteTask(void* worker);
+};
+} // namespace Trinity
+
+#endif // TRINITY_ASYNC_WORKER_POOL_HPP_DEFINED
@@ -51,6 +51,7 @@ boost::context::fiber Fiber::Finalize(Fiber* fiber)
 {
     assert(fiber->Is(State::Running));
     fiber->state_ = State::Finished;
+    fiber->DetachRelatives();
     auto context = std::move(fiber->fiber_);
     assert(IsDead(fiber->state_));
 
@@ -63,6 +64,54 @@ boost::context::fiber Fiber::Finalize(Fiber* fiber)
 Fiber::~Fiber()
 {
     assert(!previous_);
+    DetachRelatives();
+}
+
+void Fiber::SetParent(Fiber* parent) noexcept
+{
+    assert(!parent_ && "The Fiber has a parent already!");
+    parent_ = parent;
+    next_sibling_ = parent->first_child_;
+    if (next_sibling_)
+    {
+        next_sibling_->previous_sibling_ = this;
+    }
+    parent->first_child_ = this;
+}
+
+void Fiber::DetachRelatives() noexcept
+{
+    if (first_child_)
+    {
+        bool const canceled = IsCancellationRequested();
+        while (Fiber* const child = first_child_)
+        {
+            first_child_ = child->next_sibling_;
+            child->cancellation_requested_ |= canceled;
+            child->parent_ = nullptr;
+            child->next_sibling_ = nullptr;
+            child->previous_sibling_ = nullptr;
+        }
+    }
+
+    if (parent_)
+    {
+        if (previous_sibling_)
+        {
+            previous_sibling_->next_sibling_ = next_sibling_;
+        }
+        else
+        {
+            parent_->first_child_ = next_sibling_;
+        }
+        if (next_sibling_)
+        {
+            next_sibling_->previous_sibling_ = previous_sibling_;
+        }
+        parent_ = nullptr;
+        next_sibling_ = nullptr;
+        previous_sibling_ = nullptr;
+    }
 }
 
 bool Fiber::Is(State state) const noexcept
@@ -92,48 +141,76 @@ void Fiber::Cancel()
     if (Is(State::Running))
     {
         state_ = State::Canceled;
+        DetachRelatives();
         fiber_ = boost::context::fiber{};
     }
 }
 
+bool Fiber::IsCancellationRequested() const noexcept
+{
+    for (Fiber const* fiber = this; fiber; fiber = fiber->parent_)
+    {
+        if (fiber->cancellation_requested_ || fiber->Is(State::Canceled))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void IncreaseRefCounter(Fiber* fiber, StrongWeakType type) noexcept
 {
     if (type == StrongWeakType::Strong)
     {
         assert(fiber->strong_count_ > 0);
-        ++(fiber->strong_count_);
+        fiber->strong_count_.fetch_add(1, std::memory_order_relaxed);
     }
     else
     {
         assert(type == StrongWeakType::Weak);
-        ++(fiber->weak_count_);
+        fiber->weak_count_.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
 void DecreaseRefCounter(Fiber* fiber, StrongWeakType type) noexcept
 {
+    FiberPool& pool = fiber->pool_;
     if (type == StrongWeakType::Strong)
     {
         assert(fiber->strong_count_ > 0);
-        --(fiber->strong_count_);
+        if (fiber->strong_count_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        {
+            return;
+        }
 
-        if (fiber->strong_count_ == 0)
+        if (!pool.IsOwningThread())
         {
-            // Cancel the running fiber when there is
-            // no strong reference anymore
-            fiber->Cancel();
+            // The Fiber can only be canceled on the thread of its pool,
+            // which also releases the weak reference of the strong ones.
+            pool.Return(fiber);
+            return;
         }
+
+        // Cancel the running fiber when there is
+        // no strong reference anymore
+        fiber->Cancel();
     }
     else
     {
         assert(type == StrongWeakType::Weak);
-        assert(fiber->weak_count_ > 0);
-        --(fiber->weak_count_);
     }
 
-    if ((fiber->strong_count_ + fiber->weak_count_) == 0)
+    assert(fiber->weak_count_ > 0);
+    if (fiber->weak_count_.fetch_sub(1, std::memory_order_acq_rel) == 1)
     {
-        fiber->pool_.Recycle(fiber);
+        if (pool.IsOwningThread())
+        {
+            pool.Recycle(fiber);
+        }
+        else
+        {
+            pool.Return(fiber);
+        }
     }
 }
 } // namespace Trinity
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FiberConditionVariable.h"
+#include <cassert>
+
+namespace Trinity {
+void FiberConditionVariable::Wait(std::unique_lock<FiberMutex>& lock)
+{
+    assert(lock.owns_lock() && "The lock has to be locked!");
+
+    struct Relock
+    {
+        std::unique_lock<FiberMutex>& lock;
+        bool locked;
+        ~Relock()
+        {
+            // The Fiber is unwound, which can't wait for the mutex anymore
+            if (!locked && !lock.mutex()->TryLock())
+            {
+                lock.release();
+            }
+        }
+    };
+
+    Relock relock{lock, false};
+    lock.mutex()->Unlock();
+
+    // A notification of a canceled Fiber is passed to the next one
+    waiters_.Wait([this] { NotifyOne(); });
+    lock.mutex()->Lock();
+    relock.locked = true;
+}
+} // namespace Trinity
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FiberMutex.h"
+
+namespace Trinity {
+void FiberMutex::Unlock()
+{
+    assert(locked_ && "Tried to unlock an unlocked FiberMutex!");
+
+    // The mutex stays locked for the woken Fiber
+    if (!waiters_.WakeOne())
+    {
+        locked_ = false;
+    }
+}
+
+void FiberMutex::LockSlow()
+{
+    waiters_.Wait([this] { Unlock(); });
+    assert(locked_);
+}
+} // namespace Trinity
@@ -16,16 +16,43 @@
  */
 
 #include "FiberPool.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <utility>
 #include <boost/context/protected_fixedsize_stack.hpp>
 #include <boost/context/stack_traits.hpp>
 
+// TC_FIBER_ARENA allocates the Fiber stacks from large mmap backed arenas
+// which are committed lazily and backed by transparent huge pages,
+// the pages of recycled stacks are returned to the operating system.
+// Defining TC_FIBER_ARENA_HUGETLB additionally requests explicit huge pages.
+// Both are exposed as CMake options of the same name.
+#ifdef TC_FIBER_ARENA_HUGETLB
+#ifndef TC_FIBER_ARENA
+#define TC_FIBER_ARENA
+#endif
+#endif
+
 #ifndef TC_FIBER_PROTECT
-#ifndef NDEBUG
+#if !defined(NDEBUG) && !defined(TC_FIBER_ARENA)
 #define TC_FIBER_PROTECT
 #endif
 #endif
 
+#ifdef TC_FIBER_ARENA
+#ifdef TC_FIBER_PROTECT
+#error "TC_FIBER_ARENA can't be combined with TC_FIBER_PROTECT!"
+#endif
+#ifdef _WIN32
+#error "TC_FIBER_ARENA is only supported on POSIX platforms!"
+#endif
+#include <sys/mman.h>
+#endif
+
 namespace Trinity {
 static std::size_t PageSize() noexcept
 {
@@ -41,15 +68,12 @@ static std::size_t ProtectionPageSize() noexcept
 #endif
 }
 
-static std::size_t StackSize() noexcept
+static std::size_t StackSize(StackClass stack_class) noexcept
 {
-    // The size of 10 kb is required on Windows so the unwind exceptions work
-    // there. Strange behaviour was seen when using less stack space.
-    //
-    // Additionally when defining TC_FIBER_PROTECT we protect the memory
+    // When defining TC_FIBER_PROTECT we protect the memory
     // page on bottom of the stack to prevent memory corruption through
     // silent stack overflows.
-    return 1024 * 12 + ProtectionPageSize();
+    return FiberPool::SizeOf(stack_class) + ProtectionPageSize();
 }
 
 static constexpr std::size_t MaxAllocatedChunks() noexcept
@@ -72,15 +96,110 @@ static constexpr std::size_t DefaultAllocatedChunks() noexcept
 #endif
 }
 
+#ifdef TC_FIBER_ARENA
+static constexpr std::size_t HugePageSize() noexcept
+{
+    return 2 * 1024 * 1024;
+}
+
+static std::size_t AlignUp(std::size_t value, std::size_t alignment) noexcept
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+#endif
+
+static std::size_t InitialAllocatedChunks(StackClass stack_class) noexcept
+{
+#ifdef TC_FIBER_ARENA
+    // Reserve arenas which span multiple huge pages, so the kernel is able
+    // to back them with at least one aligned huge page. This is cheap
+    // since the arena pages are committed lazily on their first usage.
+    return std::max(DefaultAllocatedChunks(),
+                    (2 * HugePageSize()) / StackSize(stack_class));
+#else
+    (void)stack_class;
+    return DefaultAllocatedChunks();
+#endif
+}
+
+#ifdef TC_FIBER_ARENA
+static std::size_t ArenaHeaderSize() noexcept
+{
+    // The header stores the size of the mapping and is a full page large,
+    // so the stacks inside the arena stay page aligned.
+    return PageSize();
+}
+#endif
+
+/// Returns the physical pages of a recycled stack to the operating system,
+/// except for the top page which holds the Fiber and is reused right away.
+///
+/// \attention Only the Large stacks span enough pages to be released,
+///            the pages of recycled Small and Medium stacks stay committed
+///            and are bounded by the highest count of living Fibers.
+static void ReleaseStack(void* stack, std::size_t size) noexcept
+{
+#if defined(TC_FIBER_ARENA) && !defined(TC_FIBER_ARENA_HUGETLB)
+    // The first bytes of a free stack are used by the pool for linking
+    // the free list, so the first page is kept committed too.
+    auto const first = reinterpret_cast<uintptr_t>(stack);
+    auto const begin = AlignUp(first + 1, PageSize());
+    auto const end = (first + size - PageSize()) / PageSize() * PageSize();
+
+    // Stacks with a single releasable page aren't worth the syscall
+    if ((end > begin) && ((end - begin) >= (2 * PageSize())))
+    {
+        ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+    }
+#else
+    // Explicit huge pages can't be released partially
+    (void)stack;
+    (void)size;
+#endif
+}
+
 char* FiberPool::PoolAllocator::malloc(size_type bytes)
 {
-#ifdef TC_FIBER_PROTECT
+#if defined(TC_FIBER_PROTECT)
     // Allocate multiple pages of memory for the Fiber stack,
     // where the top page is a protected page that causes a segfault on write,
     // in order to protect against stack overflows.
     boost::context::protected_fixedsize_stack alloc(bytes);
     auto const stack = alloc.allocate();
     return static_cast<char*>(stack.sp) - stack.size + PageSize();
+#elif defined(TC_FIBER_ARENA)
+    // Only the address space is reserved here, the kernel commits
+    // the pages lazily on their first access.
+    std::size_t size = AlignUp(ArenaHeaderSize() + bytes, PageSize());
+    void* arena = MAP_FAILED;
+#ifdef TC_FIBER_ARENA_HUGETLB
+    // Explicit huge pages are reserved on mapping, otherwise accessing
+    // the arena could fail later when the huge page pool is exhausted.
+    arena = ::mmap(nullptr, AlignUp(size, HugePageSize()),
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (arena != MAP_FAILED)
+    {
+        size = AlignUp(size, HugePageSize());
+    }
+#endif
+    if (arena == MAP_FAILED)
+    {
+        // Fall back to transparent huge pages when no explicit
+        // huge pages are available.
+        arena = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (arena == MAP_FAILED)
+        {
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        ::madvise(arena, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    *static_cast<std::size_t*>(arena) = size;
+    return static_cast<char*>(arena) + ArenaHeaderSize();
 #else
     return static_cast<char*>(std::malloc(bytes));
 #endif
@@ -88,15 +207,43 @@ char* FiberPool::PoolAllocator::malloc(size_type bytes)
 
 void FiberPool::PoolAllocator::free(char* block)
 {
-#ifdef TC_FIBER_PROTECT
+#if defined(TC_FIBER_PROTECT)
     boost::context::protected_fixedsize_stack alloc(0);
     boost::context::stack_context context{0, block - PageSize()};
     alloc.deallocate(context);
+#elif defined(TC_FIBER_ARENA)
+    char* const arena = block - ArenaHeaderSize();
+    ::munmap(arena, *reinterpret_cast<std::size_t*>(arena));
 #else
     std::free(block);
 #endif
 }
 
+/// The byte which stacks are painted with when their usage is measured
+static constexpr unsigned char StackPattern = 0xA5;
+
+/// The count of Fibers with the same tag which is measured
+/// before their stack class is tuned.
+static constexpr std::size_t MinTuningSamples = 32;
+
+std::size_t StackUsage::Percentile(double fraction) const noexcept
+{
+    assert((fraction >= 0.) && (fraction <= 1.));
+    auto const required =
+        static_cast<std::size_t>(std::ceil(fraction * double(samples)));
+
+    std::size_t counted = 0;
+    for (std::size_t bucket = 0; bucket < Buckets; ++bucket)
+    {
+        counted += histogram[bucket];
+        if ((counted >= required) && (counted > 0))
+        {
+            return std::min((bucket + 1) * BucketSize, max);
+        }
+    }
+    return max;
+}
+
 boost::context::stack_context FiberPool::FiberAllocator::allocate()
 {
     // Unreachable
@@ -107,20 +254,205 @@ boost::context::stack_context FiberPool::FiberAllocator::allocate()
 void FiberPool::FiberAllocator::deallocate(boost::context::stack_context&) {}
 
 FiberPool::FiberPool()
-    : pool_(StackSize(), DefaultAllocatedChunks(), MaxAllocatedChunks())
-#ifndef NDEBUG
-      ,
-      allocated_(0)
-#endif
+    : owner_(std::this_thread::get_id()),
+      small_(StackSize(StackClass::Small),
+             InitialAllocatedChunks(StackClass::Small), MaxAllocatedChunks()),
+      medium_(StackSize(StackClass::Medium),
+              InitialAllocatedChunks(StackClass::Medium),
+              MaxAllocatedChunks()),
+      large_(StackSize(StackClass::Large),
+             InitialAllocatedChunks(StackClass::Large), MaxAllocatedChunks())
 {
 }
 
 FiberPool::~FiberPool()
 {
+    Reclaim();
     assert(allocated_ == 0 &&
            "The FiberPool is being destroyed with allocated Fibers left!");
 }
 
+std::size_t FiberPool::SizeOf(StackClass stack_class) noexcept
+{
+    switch (stack_class)
+    {
+        case StackClass::Small:
+#ifdef _WIN32
+            // The size of 10 kb is required on Windows so the unwind
+            // exceptions work there. Strange behaviour was seen when
+            // using less stack space.
+            return 1024 * 12;
+#else
+            return 1024 * 4;
+#endif
+        case StackClass::Medium:
+            return 1024 * 12;
+        case StackClass::Large:
+            return 1024 * 64;
+    }
+
+    // Unreachable
+    assert(false);
+    return 0;
+}
+
+StackClass FiberPool::ClassOf(std::size_t bytes) noexcept
+{
+    for (StackClass stack_class : {StackClass::Small, StackClass::Medium})
+    {
+        if (bytes <= SizeOf(stack_class))
+        {
+            return stack_class;
+        }
+    }
+
+    assert(bytes <= SizeOf(StackClass::Large) &&
+           "The requested stack size is larger than the largest class!");
+    if (bytes > SizeOf(StackClass::Large))
+    {
+        // Handing out a smaller stack than requested would turn into
+        // a silent stack overflow later on
+        std::terminate();
+    }
+    return StackClass::Large;
+}
+
+void FiberPool::SetStackProfiling(bool enabled) noexcept
+{
+    profile_stacks_ = enabled;
+    if (!enabled)
+    {
+        tune_stacks_ = false;
+    }
+}
+
+void FiberPool::SetStackTuning(bool enabled) noexcept
+{
+    tune_stacks_ = enabled;
+    if (enabled)
+    {
+        profile_stacks_ = true;
+    }
+}
+
+std::vector<StackUsage> FiberPool::StackReport() const
+{
+    std::vector<StackUsage> report;
+    report.reserve(usage_.size());
+    for (auto const& usage : usage_)
+    {
+        report.push_back(usage.second);
+    }
+
+    std::sort(report.begin(), report.end(),
+              [](StackUsage const& left, StackUsage const& right) {
+                  return left.max > right.max;
+              });
+    return report;
+}
+
+std::size_t FiberPool::Reclaim() noexcept
+{
+    assert(IsOwningThread() &&
+           "Fibers may only be reclaimed on the thread of their FiberPool!");
+
+    std::size_t reclaimed = 0;
+    Fiber* fiber = returned_.exchange(nullptr, std::memory_order_acquire);
+    while (fiber)
+    {
+        Fiber* const next = std::exchange(fiber->returned_next_, nullptr);
+        if (fiber->weak_count_.load(std::memory_order_acquire) == 0)
+        {
+            Recycle(fiber);
+        }
+        else
+        {
+            // The last strong reference was released on another thread,
+            // which left the weak reference of the strong ones to us.
+            fiber->Cancel();
+            DecreaseRefCounter(fiber, StrongWeakType::Weak);
+        }
+
+        ++reclaimed;
+        fiber = next;
+    }
+    return reclaimed;
+}
+
+void FiberPool::Return(Fiber* fiber) noexcept
+{
+    fiber->returned_next_ = returned_.load(std::memory_order_relaxed);
+    while (!returned_.compare_exchange_weak(fiber->returned_next_, fiber,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed))
+    {
+    }
+}
+
+void FiberPool::Reserve(std::size_t count, StackClass stack_class)
+{
+    auto& pool = PoolOf(stack_class);
+    auto const size = pool.get_requested_size();
+
+    std::vector<void*> stacks;
+    stacks.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto const stack = static_cast<char*>(pool.malloc());
+        assert(stack && "Failed to reserve a Fiber stack!");
+
+        // Fault in every page of the stack, the page faults would happen
+        // on the first usage of the stack otherwise.
+        for (std::size_t offset = 0; offset < size; offset += PageSize())
+        {
+            static_cast<char volatile*>(stack)[offset] = 0;
+        }
+        stacks.push_back(stack);
+    }
+
+    for (void* stack : stacks)
+    {
+        pool.free(stack);
+    }
+}
+
+StackClass FiberPool::SelectClass(char const* tag) const
+{
+    if (tune_stacks_)
+    {
+        auto const itr = usage_.find(tag);
+        if ((itr != usage_.end()) &&
+            (itr->second.samples >= MinTuningSamples))
+        {
+            // Leave a safety margin for deeper paths which weren't
+            // observed so far.
+            std::size_t const required =
+                itr->second.max + (itr->second.max / 4);
+            if (required <= SizeOf(StackClass::Large))
+            {
+                return ClassOf(required);
+            }
+            return StackClass::Large;
+        }
+    }
+    return StackClass::Medium;
+}
+
+boost::pool<FiberPool::PoolAllocator>&
+FiberPool::PoolOf(StackClass stack_class) noexcept
+{
+    switch (stack_class)
+    {
+        case StackClass::Small:
+            return small_;
+        case StackClass::Medium:
+            return medium_;
+        default:
+            assert(stack_class == StackClass::Large);
+            return large_;
+    }
+}
+
 template <typename T>
 T* AllocateOnStack(void*& sp, std::size_t& size)
 {
@@ -128,7 +460,9 @@ T* AllocateOnStack(void*& sp, std::size_t& size)
         (reinterpret_cast<uintptr_t>(sp) - static_cast<uintptr_t>(sizeof(T))) &
         ~static_cast<uintptr_t>(0xff));
 
-    static_assert(sizeof(Fiber) <= 64, "");
+    // The Fiber is placed below the top of the stack including
+    // the link that is used for returning it from other threads.
+    static_assert(sizeof(Fiber) <= 128, "");
     assert(storage < static_cast<char*>(sp) + size);
 
     sp = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(storage) -
@@ -142,21 +476,37 @@ T* AllocateOnStack(void*& sp, std::size_t& size)
     return static_cast<T*>(storage);
 }
 
-FiberPool::FiberAllocation FiberPool::AllocateFiber()
+FiberPool::FiberAllocation FiberPool::AllocateFiber(StackClass stack_class,
+                                                    char const* tag)
 {
-    auto const size = pool_.get_requested_size();
-    void* const stack = pool_.malloc();
+    // Recycle the Fibers which were returned from other threads first,
+    // so their stacks are reused for the new Fiber.
+    if (returned_.load(std::memory_order_relaxed))
+    {
+        Reclaim();
+    }
+
+    auto& pool = PoolOf(stack_class);
+    auto const size = pool.get_requested_size();
+    void* const stack = pool.malloc();
 
-#ifndef NDEBUG
     ++allocated_;
-#endif
 
     boost::context::stack_context context{size,
                                           static_cast<char*>(stack) + size};
 
     // Write the Fiber data on the bottom of the stack
     Fiber* fiber = AllocateOnStack<Fiber>(context.sp, context.size);
-    new (fiber) Fiber(*this, stack);
+    new (fiber) Fiber(*this, stack_class, stack, tag);
+
+    if (profile_stacks_)
+    {
+        // Paint the unused part of the stack, so the highest address
+        // which was touched can be found when the Fiber is recycled.
+        std::memset(stack, StackPattern,
+                    static_cast<char*>(context.sp) - static_cast<char*>(stack));
+        fiber->painted_ = true;
+    }
 
     boost::context::preallocated pre(context.sp, context.size, context);
 
@@ -165,11 +515,51 @@ FiberPool::FiberAllocation FiberPool::AllocateFiber()
 
 void FiberPool::Recycle(Fiber* fiber) noexcept
 {
+    auto& pool = PoolOf(fiber->stack_class_);
+    if (fiber->painted_)
+    {
+        MeasureStack(fiber, pool.get_requested_size());
+    }
+
+    void* const stack = fiber->stack_;
     fiber->~Fiber();
-    pool_.free(fiber->stack_);
+    ReleaseStack(stack, pool.get_requested_size());
+    pool.free(stack);
 
-#ifndef NDEBUG
     --allocated_;
-#endif
+}
+
+void FiberPool::MeasureStack(Fiber* fiber, std::size_t size)
+{
+    auto const* touched = static_cast<unsigned char const*>(fiber->stack_);
+    auto const* const end = touched + size;
+
+    // Skip the untouched part word by word, the stack is always aligned
+    std::uint64_t pattern;
+    std::memset(&pattern, StackPattern, sizeof(pattern));
+    while ((touched + sizeof(pattern)) <= end)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, touched, sizeof(word));
+        if (word != pattern)
+        {
+            break;
+        }
+        touched += sizeof(pattern);
+    }
+    while ((touched < end) && (*touched == StackPattern))
+    {
+        ++touched;
+    }
+
+    auto const used = static_cast<std::size_t>(end - touched);
+
+    StackUsage& usage = usage_[fiber->tag_];
+    usage.tag = fiber->tag_;
+    ++usage.samples;
+    usage.max = std::max(usage.max, used);
+    usage.total += used;
+    ++usage.histogram[std::min(used / StackUsage::BucketSize,
+                               StackUsage::Buckets - 1)];
 }
 } // namespace Trinity
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FiberScope.h"
+#include <algorithm>
+
+namespace Trinity {
+FiberScope::~FiberScope()
+{
+    Cancel();
+}
+
+void FiberScope::Cancel()
+{
+    for (FiberPtr& fiber : fibers_)
+    {
+        fiber->RequestCancellation();
+    }
+
+    // Dropping the only strong reference unwinds the suspended Fibers
+    // and recycles all of them, the vector is detached first since
+    // the unwinding Fibers could spawn new ones into this scope.
+    std::vector<FiberPtr> fibers;
+    fibers.swap(fibers_);
+    fibers.clear();
+
+    if (std::exchange(running_, 0) > 0)
+    {
+        NotifyJoiner();
+    }
+}
+
+void FiberScope::Sweep()
+{
+    if (fibers_.size() >= sweep_threshold_)
+    {
+        fibers_.erase(std::remove_if(fibers_.begin(), fibers_.end(),
+                                     [](FiberPtr const& fiber) {
+                                         return fiber->Is(
+                                             Fiber::State::Finished);
+                                     }),
+                      fibers_.end());
+        sweep_threshold_ = std::max(fibers_.size() * 2, std::size_t(64));
+    }
+}
+
+void FiberScope::OnFinished()
+{
+    assert(running_ > 0);
+    if (--running_ == 0)
+    {
+        NotifyJoiner();
+    }
+}
+
+void FiberScope::NotifyJoiner()
+{
+    if (FiberScopeJoinAwaitable* const joiner = std::exchange(joiner_, nullptr))
+    {
+        // The joiner may outlive this scope after it was continued
+        joiner->scope_ = nullptr;
+        joiner->waiter_.Notify();
+    }
+}
+} // namespace Trinity
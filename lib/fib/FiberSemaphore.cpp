@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FiberSemaphore.h"
+
+namespace Trinity {
+void FiberSemaphore::Release(std::size_t count)
+{
+    for (; count > 0; --count)
+    {
+        if (!waiters_.WakeOne())
+        {
+            count_ += count;
+            return;
+        }
+    }
+}
+
+void FiberSemaphore::AcquireSlow()
+{
+    waiters_.Wait([this] { Release(); });
+}
+} // namespace Trinity
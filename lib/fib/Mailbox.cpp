@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Mailbox.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace Trinity {
+namespace Detail {
+#ifdef __linux__
+MailboxSignal::MailboxSignal() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    assert(fd_ >= 0 && "Failed to create the eventfd!");
+}
+
+MailboxSignal::~MailboxSignal()
+{
+    close(fd_);
+}
+
+void MailboxSignal::Reset() noexcept
+{
+    if (signaled_.exchange(false, std::memory_order_seq_cst))
+    {
+        eventfd_t value;
+        (void)eventfd_read(fd_, &value);
+    }
+
+    // Messages which were posted before the signal was cleared
+    // have to be visible to the following drain.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+bool MailboxSignal::Wait(std::chrono::milliseconds timeout) noexcept
+{
+    pollfd descriptor{fd_, POLLIN, 0};
+    int result;
+    do
+    {
+        result = poll(&descriptor, 1, static_cast<int>(timeout.count()));
+    } while (result < 0 && errno == EINTR);
+    return result > 0;
+}
+
+int MailboxSignal::NativeHandle() const noexcept
+{
+    return fd_;
+}
+
+void MailboxSignal::Raise() noexcept
+{
+    (void)eventfd_write(fd_, 1);
+}
+#else
+MailboxSignal::MailboxSignal() = default;
+
+MailboxSignal::~MailboxSignal() = default;
+
+void MailboxSignal::Reset() noexcept
+{
+    if (signaled_.exchange(false, std::memory_order_seq_cst))
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        notified_ = false;
+    }
+
+    // Messages which were posted before the signal was cleared
+    // have to be visible to the following drain.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+bool MailboxSignal::Wait(std::chrono::milliseconds timeout) noexcept
+{
+    std::unique_lock<std::mutex> guard(mutex_);
+    return condition_.wait_for(guard, timeout, [&] { return notified_; });
+}
+
+int MailboxSignal::NativeHandle() const noexcept
+{
+    return -1;
+}
+
+void MailboxSignal::Raise() noexcept
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        notified_ = true;
+    }
+    condition_.notify_one();
+}
+#endif
+} // namespace Detail
+} // namespace Trinity
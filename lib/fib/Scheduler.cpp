@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Scheduler.h"
+#include <cassert>
+#include <utility>
+
+namespace Trinity {
+static thread_local Scheduler* current = nullptr;
+
+Scheduler::Scheduler() noexcept : previous_(std::exchange(current, this)) {}
+
+Scheduler::~Scheduler()
+{
+    assert(current == this &&
+           "The Schedulers of a thread must be destroyed in reverse order!");
+
+    // The posted tasks may hold resources which are released when they run
+    RunRemote();
+    current = previous_;
+
+    // Release the Fibers which were never resumed
+    while (Fiber* const fiber = head_)
+    {
+        head_ = std::exchange(fiber->next_, nullptr);
+        fiber->scheduled_ = false;
+        DecreaseRefCounter(fiber, StrongWeakType::Weak);
+    }
+
+    // Drop the Tasks which were never run, they stay suspended
+    while (Detail::ScheduledTask* const task = tasks_head_)
+    {
+        tasks_head_ = std::exchange(task->next, nullptr);
+        task->scheduler = nullptr;
+    }
+    tasks_tail_ = nullptr;
+}
+
+void Scheduler::Schedule(Fiber* fiber)
+{
+    assert(fiber);
+    assert(fiber->Is(Fiber::State::Running) &&
+           "Only suspended Fibers can be scheduled!");
+
+    if (fiber->scheduled_)
+    {
+        return;
+    }
+
+    // The queue holds a weak reference so the Fiber stays valid
+    // even when it is canceled while it is queued.
+    IncreaseRefCounter(fiber, StrongWeakType::Weak);
+    fiber->scheduled_ = true;
+
+    if (tail_)
+    {
+        tail_->next_ = fiber;
+    }
+    else
+    {
+        head_ = fiber;
+    }
+    tail_ = fiber;
+}
+
+void Scheduler::Schedule(Detail::ScheduledTask* task) noexcept
+{
+    assert(task);
+    assert((!task->scheduler || (task->scheduler == this)) &&
+           "The task is queued on another Scheduler!");
+
+    if (task->scheduler)
+    {
+        return;
+    }
+
+    task->scheduler = this;
+    if (tasks_tail_)
+    {
+        tasks_tail_->next = task;
+    }
+    else
+    {
+        tasks_head_ = task;
+    }
+    tasks_tail_ = task;
+}
+
+void Scheduler::Unschedule(Detail::ScheduledTask* task) noexcept
+{
+    assert(task->scheduler == this && "The task isn't queued here!");
+
+    // Tasks are only unscheduled when they are destroyed before they
+    // were run, which is rare enough to search the queue.
+    Detail::ScheduledTask* previous = nullptr;
+    for (Detail::ScheduledTask* current = tasks_head_; current;
+         current = current->next)
+    {
+        if (current == task)
+        {
+            if (previous)
+            {
+                previous->next = task->next;
+            }
+            else
+            {
+                tasks_head_ = task->next;
+            }
+            if (tasks_tail_ == task)
+            {
+                tasks_tail_ = previous;
+            }
+            break;
+        }
+        previous = current;
+    }
+
+    task->next = nullptr;
+    task->scheduler = nullptr;
+}
+
+void Scheduler::Post(Detail::RemoteTask* task) noexcept
+{
+    assert(task);
+
+    // The Scheduler may be destroyed right after the task was queued
+    Detail::Continuation const wakeup = wakeup_;
+
+    task->next = remote_.load(std::memory_order_relaxed);
+    while (!remote_.compare_exchange_weak(task->next, task,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed))
+    {
+    }
+
+    // A non empty queue was signaled already by the first task
+    if (!task->next && wakeup)
+    {
+        wakeup();
+    }
+}
+
+void Scheduler::RunRemote()
+{
+    // Avoid the exchange when nothing was posted
+    if (remote_.load(std::memory_order_relaxed) == nullptr)
+    {
+        return;
+    }
+
+    Detail::RemoteTask* task =
+        remote_.exchange(nullptr, std::memory_order_acquire);
+
+    // Restore the order in which the tasks were posted
+    Detail::RemoteTask* ordered = nullptr;
+    while (task)
+    {
+        Detail::RemoteTask* const next = task->next;
+        task->next = ordered;
+        ordered = task;
+        task = next;
+    }
+
+    while (ordered)
+    {
+        // The task may destroy itself
+        Detail::RemoteTask* const next = ordered->next;
+        ordered->run(ordered);
+        ordered = next;
+    }
+}
+
+bool Scheduler::RunOne()
+{
+    if (!head_ && !tasks_head_)
+    {
+        RunRemote();
+    }
+
+    Fiber* const fiber = head_;
+    if (!fiber)
+    {
+        Detail::ScheduledTask* const task = tasks_head_;
+        if (!task)
+        {
+            return false;
+        }
+
+        tasks_head_ = std::exchange(task->next, nullptr);
+        if (!tasks_head_)
+        {
+            tasks_tail_ = nullptr;
+        }
+        task->scheduler = nullptr;
+
+        // The task may destroy itself
+        task->run(task);
+        return true;
+    }
+
+    head_ = std::exchange(fiber->next_, nullptr);
+    if (!head_)
+    {
+        tail_ = nullptr;
+    }
+    fiber->scheduled_ = false;
+
+    // Adopt the reference which was acquired in Schedule
+    WeakFiberPtr guard(fiber, false);
+    if (fiber->Is(Fiber::State::Running))
+    {
+        fiber->Resume();
+    }
+    return true;
+}
+
+std::size_t Scheduler::Run()
+{
+    std::size_t resumed = 0;
+    while (RunOne())
+    {
+        ++resumed;
+    }
+    return resumed;
+}
+
+Scheduler* Scheduler::Current() noexcept
+{
+    return current;
+}
+
+void Wakeup(Fiber* fiber)
+{
+    if (Scheduler* const scheduler = Scheduler::Current())
+    {
+        scheduler->Schedule(fiber);
+    }
+    else
+    {
+        fiber->Resume();
+    }
+}
+} // namespace Trinity
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TaskQueue.h"
+#include <algorithm>
+#include <cassert>
+#include "FiberPool.h"
+
+namespace Trinity {
+TaskQueue::TaskQueue(FiberPool& pool, std::size_t max_idle)
+    : pool_(pool), max_idle_(max_idle)
+{
+}
+
+TaskQueue::~TaskQueue()
+{
+    assert(!running_ && "The TaskQueue was destroyed from one of its tasks!");
+
+    // Cancel the parked workers and the ones attached to suspended tasks
+    idle_.clear();
+    workers_.clear();
+}
+
+std::size_t TaskQueue::Run()
+{
+    assert(!running_ && "TaskQueue::Run may not be called from a task!");
+    running_ = true;
+
+    while (!tasks_.empty())
+    {
+        Fiber* worker;
+        if (idle_.empty())
+        {
+            worker = SpawnWorker();
+        }
+        else
+        {
+            worker = idle_.back();
+            idle_.pop_back();
+        }
+
+        // Returns when the queue was drained, or when a task suspended
+        // which leaves the worker attached to the task.
+        worker->Resume();
+    }
+
+    running_ = false;
+    return std::exchange(executed_, 0);
+}
+
+Fiber* TaskQueue::SpawnWorker()
+{
+    if (workers_.size() >= sweep_threshold_)
+    {
+        workers_.erase(std::remove_if(workers_.begin(), workers_.end(),
+                                      [](FiberPtr const& worker) {
+                                          return worker->Is(
+                                              Fiber::State::Finished);
+                                      }),
+                       workers_.end());
+        sweep_threshold_ =
+            std::max(workers_.size() * 2, std::size_t(64));
+    }
+
+    workers_.push_back(pool_.Spawn([this] { Work(); }));
+    return workers_.back().Get();
+}
+
+void TaskQueue::Work()
+{
+    Fiber* const self = ThisFiber();
+    for (;;)
+    {
+        while (!tasks_.empty())
+        {
+            Detail::Job task = std::move(tasks_.front());
+            tasks_.pop_front();
+            task();
+            ++executed_;
+        }
+
+        // Workers which were attached to a suspended task are finished
+        // when there are enough parked workers already.
+        if (idle_.size() >= max_idle_)
+        {
+            return;
+        }
+
+        idle_.push_back(self);
+        self->Suspend();
+    }
+}
+} // namespace Trinity
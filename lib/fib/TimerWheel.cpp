@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimerWheel.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <utility>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Trinity {
+static unsigned HighestBit(std::uint64_t value) noexcept
+{
+    assert(value != 0);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return 63U - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+}
+
+static unsigned LowestBit(std::uint64_t value) noexcept
+{
+    assert(value != 0);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+}
+
+TimerWheel::TimerWheel(TimePoint now) : now_(now.count())
+{
+    assert(now_ >= 0 && "The time of the wheel may not be negative!");
+    heads_.fill(Invalid);
+}
+
+TimerWheel::~TimerWheel() = default;
+
+Future<> TimerWheel::WaitUntil(TimePoint deadline)
+{
+    if (deadline.count() <= now_)
+    {
+        return MakeReadyFuture();
+    }
+
+    Future<> future;
+    Schedule(deadline, future.GetPromise());
+    return future;
+}
+
+TimerId TimerWheel::Schedule(TimePoint deadline, Promise<> promise)
+{
+    if (deadline.count() <= now_)
+    {
+        promise.Resolve();
+        return TimerId{};
+    }
+
+    std::uint32_t const index = Allocate();
+    Node& node = nodes_[index];
+    node.deadline = deadline.count();
+    node.promise.emplace(std::move(promise));
+    Link(index);
+    return TimerId(index, node.generation);
+}
+
+bool TimerWheel::Cancel(TimerId id)
+{
+    if (!id || (id.index_ >= nodes_.size()))
+    {
+        return false;
+    }
+
+    Node& node = nodes_[id.index_];
+    if ((node.generation != id.generation_) || (node.slot == Invalid))
+    {
+        return false;
+    }
+
+    Unlink(id.index_);
+    Free(id.index_);
+    return true;
+}
+
+std::size_t TimerWheel::Advance(TimePoint now)
+{
+    assert(now.count() >= now_ && "Tried to move the time backwards!");
+
+    std::size_t resolved = 0;
+    std::vector<Promise<>> expired;
+    for (;;)
+    {
+        std::int64_t const next = NextEvent();
+        if (next > now.count())
+        {
+            // No timer changes its slot until the given time point,
+            // thus we can skip the ticks in between.
+            now_ = now.count();
+            break;
+        }
+
+        auto const changed = static_cast<std::uint64_t>(now_ ^ next);
+        now_ = next;
+
+        if ((changed >> (SlotBits * Levels)) != 0)
+        {
+            Cascade(Overflow);
+        }
+        for (std::size_t level = Levels - 1; level > 0; --level)
+        {
+            if ((changed >> (SlotBits * level)) != 0)
+            {
+                Cascade(static_cast<std::uint32_t>(
+                    (level * Slots) +
+                    ((now_ >> (SlotBits * level)) & (Slots - 1))));
+            }
+        }
+        Cascade(static_cast<std::uint32_t>(now_ & (Slots - 1)));
+
+        // The Promises are resolved after the wheel is consistent again,
+        // since resumed Fibers may schedule or cancel timers.
+        std::swap(expired, expired_);
+        for (auto& promise : expired)
+        {
+            promise.Resolve();
+        }
+        resolved += expired.size();
+        expired.clear();
+
+        if (expired_.empty())
+        {
+            std::swap(expired, expired_);
+        }
+    }
+    return resolved;
+}
+
+std::uint32_t TimerWheel::Allocate()
+{
+    ++size_;
+
+    if (free_ != Invalid)
+    {
+        return std::exchange(free_, nodes_[free_].next);
+    }
+
+    nodes_.emplace_back();
+    return static_cast<std::uint32_t>(nodes_.size() - 1);
+}
+
+void TimerWheel::Free(std::uint32_t index)
+{
+    Node& node = nodes_[index];
+    node.promise = boost::none;
+    node.slot = Invalid;
+    node.prev = Invalid;
+    node.next = std::exchange(free_, index);
+
+    // Invalidate all TimerIds which refer to this node
+    if (++node.generation == 0)
+    {
+        node.generation = 1;
+    }
+
+    --size_;
+}
+
+void TimerWheel::Link(std::uint32_t index)
+{
+    Node& node = nodes_[index];
+    assert(node.deadline > now_);
+
+    // Timers are placed on the level of the highest slot group which differs
+    // from the current time, so they are moved down one level at most
+    // every time this group changes.
+    auto const diff = static_cast<std::uint64_t>(node.deadline ^ now_);
+    if ((diff >> (SlotBits * Levels)) != 0)
+    {
+        node.slot = Overflow;
+    }
+    else
+    {
+        std::size_t const level = HighestBit(diff) / SlotBits;
+        std::size_t const slot =
+            (node.deadline >> (SlotBits * level)) & (Slots - 1);
+        occupied_[level] |= std::uint64_t(1) << slot;
+        node.slot = static_cast<std::uint32_t>((level * Slots) + slot);
+    }
+
+    node.prev = Invalid;
+    node.next = std::exchange(heads_[node.slot], index);
+    if (node.next != Invalid)
+    {
+        nodes_[node.next].prev = index;
+    }
+}
+
+void TimerWheel::Unlink(std::uint32_t index)
+{
+    Node& node = nodes_[index];
+    assert(node.slot != Invalid);
+
+    if (node.prev != Invalid)
+    {
+        nodes_[node.prev].next = node.next;
+    }
+    else
+    {
+        heads_[node.slot] = node.next;
+    }
+
+    if (node.next != Invalid)
+    {
+        nodes_[node.next].prev = node.prev;
+    }
+
+    if ((heads_[node.slot] == Invalid) && (node.slot != Overflow))
+    {
+        occupied_[node.slot / Slots] &= ~(std::uint64_t(1)
+                                          << (node.slot % Slots));
+    }
+}
+
+void TimerWheel::Expire(std::uint32_t index)
+{
+    expired_.push_back(std::move(*nodes_[index].promise));
+    Free(index);
+}
+
+void TimerWheel::Cascade(std::uint32_t slot)
+{
+    std::uint32_t index = std::exchange(heads_[slot], Invalid);
+    if (slot != Overflow)
+    {
+        occupied_[slot / Slots] &= ~(std::uint64_t(1) << (slot % Slots));
+    }
+
+    while (index != Invalid)
+    {
+        std::uint32_t const next = nodes_[index].next;
+        if (nodes_[index].deadline <= now_)
+        {
+            Expire(index);
+        }
+        else
+        {
+            Link(index);
+        }
+        index = next;
+    }
+}
+
+std::int64_t TimerWheel::NextEvent() const noexcept
+{
+    for (std::size_t level = 0; level < Levels; ++level)
+    {
+        std::size_t const shift = SlotBits * level;
+        std::size_t const current = (now_ >> shift) & (Slots - 1);
+
+        // Only the slots after the current one can be occupied
+        std::uint64_t const pending =
+            occupied_[level] & ~((std::uint64_t(2) << current) - 1);
+        if (pending != 0)
+        {
+            // Slots on lower levels always expire before higher ones
+            std::size_t const upper = shift + SlotBits;
+            return ((now_ >> upper) << upper) |
+                   static_cast<std::int64_t>(LowestBit(pending)) << shift;
+        }
+    }
+
+    if (heads_[Overflow] != Invalid)
+    {
+        std::size_t const upper = SlotBits * Levels;
+        return ((now_ >> upper) + 1) << upper;
+    }
+    return std::numeric_limits<std::int64_t>::max();
+}
+} // namespace Trinity
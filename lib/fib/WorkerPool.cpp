@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <thread>
+#include "Fiber.h"
+#include "FiberPool.h"
+#include "Scheduler.h"
+
+namespace Trinity {
+struct WorkerPool::Worker
+{
+    explicit Worker(WorkerPool* owner) noexcept : pool(owner) {}
+
+    /// The pool which owns this worker, since a job may post to other pools
+    WorkerPool* const pool;
+    /// Is set when a task was posted to the Scheduler of the worker
+    /// from another thread, for instance to resolve a RemoteFuture.
+    std::atomic<bool> signaled{false};
+    std::mutex mutex;
+    std::deque<Detail::Job> queue;
+    std::thread thread;
+};
+
+WorkerPool::Worker*& WorkerPool::ThisWorker() noexcept
+{
+    static thread_local Worker* current = nullptr;
+    return current;
+}
+
+std::size_t WorkerPool::DefaultWorkerCount() noexcept
+{
+    return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+WorkerPool::WorkerPool(std::size_t workers, std::size_t max_fibers)
+    : max_fibers_(max_fibers)
+{
+    assert(workers > 0 && "Tried to create a WorkerPool without workers!");
+
+    workers_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i)
+    {
+        workers_.push_back(std::make_unique<Worker>(this));
+    }
+
+    // The threads are started after all workers were created,
+    // since they steal from each other.
+    for (auto& worker : workers_)
+    {
+        Worker* const current = worker.get();
+        worker->thread = std::thread([this, current] { Run(*current); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(sleep_mutex_);
+        stopping_ = true;
+    }
+    sleep_.notify_all();
+    parked_.notify_all();
+
+    for (auto& worker : workers_)
+    {
+        worker->thread.join();
+    }
+}
+
+void WorkerPool::Enqueue(Detail::Job job)
+{
+    // Prefer the run queue of the current worker for a better locality
+    Worker* worker = ThisWorker();
+    if (!worker || (worker->pool != this))
+    {
+        worker = workers_[next_.fetch_add(1, std::memory_order_relaxed) %
+                          workers_.size()]
+                     .get();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(worker->mutex);
+        worker->queue.push_back(std::move(job));
+    }
+
+    // Pairs with the sequentially consistent access of sleeping_ and pending_
+    // inside Sleep, which makes it impossible to miss a wakeup.
+    ++pending_;
+    if (sleeping_.load() > 0)
+    {
+        {
+            std::lock_guard<std::mutex> guard(sleep_mutex_);
+        }
+        sleep_.notify_one();
+    }
+}
+
+bool WorkerPool::Pop(Worker& worker, Detail::Job& job)
+{
+    std::lock_guard<std::mutex> guard(worker.mutex);
+    if (worker.queue.empty())
+    {
+        return false;
+    }
+
+    // The owner takes the most recently queued job since its data
+    // is most likely still hot in the cache.
+    job = std::move(worker.queue.back());
+    worker.queue.pop_back();
+    --pending_;
+    return true;
+}
+
+bool WorkerPool::Steal(Worker& thief, Detail::Job& job)
+{
+    auto const begin = static_cast<std::size_t>(
+        std::find_if(workers_.begin(), workers_.end(),
+                     [&](auto const& worker) { return worker.get() == &thief; }) -
+        workers_.begin());
+
+    for (std::size_t i = 1; i < workers_.size(); ++i)
+    {
+        Worker& victim = *workers_[(begin + i) % workers_.size()];
+
+        std::unique_lock<std::mutex> guard(victim.mutex, std::try_to_lock);
+        if (guard.owns_lock() && !victim.queue.empty())
+        {
+            // Thieves take the oldest job from the opposite end of the queue
+            job = std::move(victim.queue.front());
+            victim.queue.pop_front();
+            --pending_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::Sleep(Worker& worker)
+{
+    std::unique_lock<std::mutex> guard(sleep_mutex_);
+    ++sleeping_;
+    sleep_.wait(guard, [&] {
+        return pending_.load() > 0 || stopping_ || worker.signaled.load();
+    });
+    --sleeping_;
+}
+
+void WorkerPool::Park(Worker& worker)
+{
+    // Suspended Fibers are only woken up by Fibers of the same worker or
+    // through tasks posted from other threads, thus an exhausted worker
+    // without ready Fibers can't make progress until one of them arrives.
+    std::unique_lock<std::mutex> guard(sleep_mutex_);
+    parked_.wait(guard,
+                 [&] { return stopping_.load() || worker.signaled.load(); });
+}
+
+void WorkerPool::OnRemoteTask(void* context)
+{
+    Worker* const worker = static_cast<Worker*>(context);
+    WorkerPool* const pool = worker->pool;
+
+    // Pairs with the predicates of Sleep and Park which are checked
+    // while the mutex is locked, which makes it impossible to miss a wakeup.
+    worker->signaled = true;
+    {
+        std::lock_guard<std::mutex> guard(pool->sleep_mutex_);
+    }
+
+    // The condition variables are shared by all workers
+    pool->sleep_.notify_all();
+    pool->parked_.notify_all();
+}
+
+void WorkerPool::Run(Worker& worker)
+{
+    ThisWorker() = &worker;
+
+    FiberPool pool;
+    pool.SetMaxFibers(max_fibers_);
+    Scheduler scheduler;
+    scheduler.SetWakeup(Detail::Continuation{&OnRemoteTask, &worker});
+    // The Fibers which were started by this worker and are still suspended
+    std::vector<FiberPtr> suspended;
+
+    auto const sweep = [&] {
+        suspended.erase(std::remove_if(suspended.begin(), suspended.end(),
+                                       [](FiberPtr const& fiber) {
+                                           return !fiber->Is(
+                                               Fiber::State::Running);
+                                       }),
+                        suspended.end());
+    };
+
+    std::size_t sweep_threshold = 64;
+    Detail::Job job;
+    for (;;)
+    {
+        // Continue the Fibers which became ready before starting new jobs,
+        // the tasks posted from now on signal the worker again.
+        worker.signaled.exchange(false);
+        scheduler.Run();
+
+        if (!pool.IsExhausted() && (Pop(worker, job) || Steal(worker, job)))
+        {
+            FiberPtr fiber = pool.Spawn(std::move(job));
+            fiber->Resume();
+
+            if (fiber->Is(Fiber::State::Running))
+            {
+                suspended.push_back(std::move(fiber));
+
+                if (suspended.size() >= sweep_threshold)
+                {
+                    sweep();
+                    sweep_threshold = std::max(suspended.size() * 2,
+                                               std::size_t(64));
+                }
+            }
+            continue;
+        }
+
+        sweep();
+
+        // Fibers which were released on other threads free their slots
+        // only after they were reclaimed.
+        pool.Reclaim();
+
+        if (stopping_ && (pending_.load() == 0))
+        {
+            break;
+        }
+
+        if (pool.IsExhausted())
+        {
+            if (stopping_)
+            {
+                // Lift the limit so the remaining jobs are run before
+                // the suspended Fibers are canceled.
+                pool.SetMaxFibers(0);
+            }
+            else
+            {
+                Park(worker);
+            }
+            continue;
+        }
+
+        Sleep(worker);
+    }
+
+    // Cancel all Fibers that are still suspended
+    suspended.clear();
+    ThisWorker() = nullptr;
+}
+} // namespace Trinity
@@ -15,12 +15,40 @@
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 #include "Async.h"
 #include "AsyncCreatureAI.h"
 #include "Await.h"
+#include "CancellationToken.h"
+#include "Channel.h"
+#include "Event.h"
+#include "FiberConditionVariable.h"
+#include "FiberMutex.h"
 #include "FiberPool.h"
+#include "FiberScope.h"
+#include "FiberSemaphore.h"
+#include "Mailbox.h"
 #include "Future.h"
+#include "RemoteFuture.h"
+#include "Scheduler.h"
+#include "Select.h"
+#include "SharedFuture.h"
+#include "TaskQueue.h"
+#include "TimerWheel.h"
+#include "WhenAll.h"
+#include "WhenAny.h"
+#include "WorkerPool.h"
 
 using namespace Trinity;
 
@@ -135,6 +163,1144 @@ static void TestAsync()
 
         ptr->Cancel();
     }
+
+    {
+        // Dropping a pending Future cancels its resolver together with
+        // the Promise it holds.
+        auto ptr = pool.Spawn([] {
+            auto child = Async([] { ThisFiber()->Suspend(); });
+            ThisFiber()->Suspend();
+        });
+        ptr->Resume();
+        ptr->Cancel();
+    }
+
+    {
+        // Inline launched callables don't require a Fiber
+        auto future = Async(Launch::Inline, [] { return 3; });
+        assert(future.IsReady());
+        Async(Launch::Inline, [] {});
+
+        int result = 0;
+        auto ptr = pool.Spawn([&] {
+            result = await Async(Launch::Inline, [] {
+                // Suspends the caller together with the callable
+                ThisFiber()->Suspend();
+                return 5;
+            });
+        });
+        ptr->Resume();
+        assert(result == 0);
+        ptr->Resume();
+        assert(result == 5);
+        assert(ptr->Is(Fiber::State::Finished));
+        assert(pool.Size() == 1);
+    }
+}
+
+static void TestThen()
+{
+    {
+        Future<int> future;
+        auto promise = future.GetPromise();
+
+        auto doubled = future.Then([](int value) { return value * 2; });
+        bool finished = false;
+        auto done = doubled.Then([&](int value) {
+            (void)value;
+            assert(value == 8);
+            finished = true;
+        });
+        assert(!doubled.IsReady() && !finished);
+
+        // Continuations run on the stack of the resolver
+        promise.Resolve(4);
+        assert(doubled.IsReady() && done.IsReady() && finished);
+    }
+
+    {
+        // Ready Futures invoke the continuation immediately
+        auto future = MakeReadyFuture(1, 2);
+        auto sum = future.Then([](int left, int right) { return left + right; });
+        assert(sum.IsReady());
+    }
+
+    {
+        // Dropping the continued Future drops the continuation
+        // without invoking it
+        auto token = std::make_shared<int>(0);
+        bool invoked = false;
+        std::unique_ptr<Promise<>> source_promise;
+        {
+            Future<> source;
+            source_promise.reset(new Promise<>(source.GetPromise()));
+            {
+                Future<> dependent =
+                    source.Then([&invoked, token] { invoked = true; });
+                assert(token.use_count() == 2);
+            }
+        }
+        assert(token.use_count() == 1);
+        source_promise->Resolve();
+        assert(!invoked);
+    }
+
+    {
+        // Continuations resolve their Future through the source Promise
+        Future<> future;
+        auto promise = future.GetPromise();
+        auto next = future.Then([] { return 1; });
+        promise.Resolve();
+        assert(next.IsReady());
+    }
+
+    {
+        FiberPool pool;
+        Future<int> future;
+        auto promise = future.GetPromise();
+        int result = 0;
+        auto fiber = pool.Spawn([&] {
+            result = await future.Then([](int value) { return value + 1; });
+        });
+        fiber->Resume();
+        promise.Resolve(1);
+        assert(result == 2);
+    }
+}
+
+static void TestWhenAll()
+{
+    FiberPool pool;
+    Scheduler scheduler;
+    {
+        Future<int> first;
+        Future<> second;
+        auto first_promise = first.GetPromise();
+        auto second_promise = second.GetPromise();
+
+        std::tuple<int, std::tuple<>, int, bool> result;
+        auto fiber = pool.Spawn([&] {
+            result = await WhenAll(std::move(first), std::move(second),
+                                   MakeReadyFuture(3), Async([] {
+                                       return true;
+                                   }));
+        });
+        fiber->Resume();
+
+        first_promise.Resolve(1);
+        assert(scheduler.IsEmpty());
+        second_promise.Resolve();
+
+        // The waiting Fiber is continued once after the last input
+        assert(scheduler.Run() == 1);
+        assert(fiber->Is(Fiber::State::Finished));
+        assert(std::get<0>(result) == 1);
+        assert(std::get<2>(result) == 3);
+        assert(std::get<3>(result));
+    }
+
+    {
+        std::vector<Future<int>> futures(16);
+        std::vector<Promise<int>> promises;
+        for (auto& future : futures)
+        {
+            promises.push_back(future.GetPromise());
+        }
+
+        int sum = 0;
+        auto fiber = pool.Spawn([&] {
+            await WhenAll(futures);
+            for (auto& future : futures)
+            {
+                sum += await std::move(future);
+            }
+        });
+        fiber->Resume();
+
+        for (int i = 0; i < 16; ++i)
+        {
+            promises[i].Resolve(i);
+        }
+        assert(scheduler.Run() == 1);
+        assert(sum == 120);
+    }
+
+    {
+        // A canceled waiter is removed from the inputs of the range
+        std::vector<Future<int>> futures(4);
+        std::vector<Promise<int>> promises;
+        for (auto& future : futures)
+        {
+            promises.push_back(future.GetPromise());
+        }
+
+        auto fiber = pool.Spawn([&] { await WhenAll(futures); });
+        fiber->Resume();
+        promises[0].Resolve(0);
+        fiber = nullptr;
+
+        for (int i = 1; i < 4; ++i)
+        {
+            promises[i].Resolve(i);
+        }
+        assert(scheduler.IsEmpty());
+    }
+}
+
+static void TestWhenAny()
+{
+    FiberPool pool;
+    {
+        struct Unwind
+        {
+            bool& unwound;
+            ~Unwind() { unwound = true; }
+        };
+
+        Future<int> damage;
+        Future<> timeout;
+        auto damage_promise = damage.GetPromise();
+        auto timeout_promise = timeout.GetPromise();
+
+        bool unwound = false;
+        std::size_t index = 0;
+        auto fiber = pool.Spawn([&] {
+            auto result = await WhenAny(
+                Async([&unwound, damage = std::move(damage)]() mutable {
+                    Unwind guard{unwound};
+                    return await std::move(damage);
+                }),
+                std::move(timeout));
+            index = result.index;
+        });
+        fiber->Resume();
+        assert(pool.Size() == 2);
+
+        // The losing branch is canceled and recycled right away
+        timeout_promise.Resolve();
+        assert(index == 1);
+        assert(unwound);
+        assert(fiber->Is(Fiber::State::Finished));
+        assert(pool.Size() == 1);
+        damage_promise.Resolve(1);
+    }
+
+    {
+        std::vector<Future<int>> futures(4);
+        std::vector<Promise<int>> promises;
+        for (auto& future : futures)
+        {
+            promises.push_back(future.GetPromise());
+        }
+
+        std::pair<std::size_t, int> result;
+        auto fiber = pool.Spawn([&] { result = await WhenAny(futures); });
+        fiber->Resume();
+
+        promises[2].Resolve(7);
+        assert(result.first == 2);
+        assert(result.second == 7);
+        assert(futures[1].IsCanceled());
+        assert(promises[1].IsCanceled());
+        promises[1].Resolve(1);
+    }
+
+    {
+        // Losing inputs which can't be canceled are deregistered,
+        // thus the combinators can be nested.
+        Future<int> spell;
+        Future<int> melee;
+        Future<> done;
+        auto spell_promise = spell.GetPromise();
+        auto melee_promise = melee.GetPromise();
+        auto done_promise = done.GetPromise();
+
+        std::size_t index = 0;
+        auto fiber = pool.Spawn([&] {
+            auto result =
+                await WhenAny(std::move(spell), WhenAll(std::move(melee)));
+            index = result.index;
+            await std::move(done);
+        });
+        fiber->Resume();
+
+        spell_promise.Resolve(1);
+        assert(index == 0);
+        melee_promise.Resolve(2);
+        done_promise.Resolve();
+        assert(fiber->Is(Fiber::State::Finished));
+    }
+}
+
+static void TestCancellation()
+{
+    FiberPool pool;
+
+    {
+        Future<int> future;
+        auto promise = future.GetPromise();
+        assert(!future.IsCanceled());
+        assert(!promise.IsCanceled());
+        future.Cancel();
+        assert(future.IsCanceled());
+        assert(promise.IsCanceled());
+    }
+
+    {
+        // The resolver polls its token and stops once its result
+        // isn't needed anymore, the extra reference keeps it alive.
+        FiberPtr child;
+        Future<> resume;
+        auto resume_promise = resume.GetPromise();
+        std::size_t iterations = 0;
+
+        Future<int> result;
+        auto fiber = pool.Spawn([&] {
+            result = Async([&] {
+                child = FiberPtr(ThisFiber());
+                auto token = CancellationToken::Current();
+                while (!token.IsCancellationRequested())
+                {
+                    ++iterations;
+                    await std::move(resume);
+                }
+                return 0;
+            });
+        });
+        fiber->Resume();
+        assert(iterations == 1);
+        assert(!child->IsCancellationRequested());
+
+        result.Cancel();
+        assert(child->IsCancellationRequested());
+        resume_promise.Resolve();
+        assert(iterations == 1);
+        assert(child->Is(Fiber::State::Finished));
+    }
+
+    {
+        // The cancellation propagates from the parent to its children
+        FiberPtr grandchild;
+        Future<> resume;
+        auto resume_promise = resume.GetPromise();
+        bool canceled = false;
+
+        Future<> result;
+        auto fiber = pool.Spawn([&] {
+            result = Async([&] {
+                await Async([&] {
+                    grandchild = FiberPtr(ThisFiber());
+                    await std::move(resume);
+                    canceled =
+                        CancellationToken::Current().IsCancellationRequested();
+                });
+            });
+        });
+        fiber->Resume();
+        assert(!grandchild->IsCancellationRequested());
+
+        // Resume the grandchild first while its parent is still alive
+        result.Cancel();
+        assert(grandchild->IsCancellationRequested());
+        resume_promise.Resolve();
+        assert(canceled);
+    }
+
+    {
+        // A finished parent doesn't keep its stack alive for its children,
+        // which are still canceled through their Future.
+        FiberPtr child;
+        Future<> resume;
+        auto resume_promise = resume.GetPromise();
+
+        Future<> result;
+        auto fiber = pool.Spawn([&] {
+            result = Async([&] {
+                child = FiberPtr(ThisFiber());
+                await std::move(resume);
+            });
+        });
+        fiber->Resume();
+        assert(fiber->Is(Fiber::State::Finished));
+
+        std::size_t const alive = pool.Size();
+        fiber = nullptr;
+        assert(pool.Size() == alive - 1);
+        assert(!child->IsCancellationRequested());
+
+        result.Cancel();
+        assert(child->IsCancellationRequested());
+        resume_promise.Resolve();
+        assert(child->Is(Fiber::State::Finished));
+    }
+}
+
+static void TestFiberScope()
+{
+    FiberPool pool;
+
+    {
+        // Joining waits until all Fibers of the scope are finished
+        std::vector<Promise<>> promises;
+        std::size_t finished = 0;
+        bool joined = false;
+
+        FiberScope scope(pool);
+        for (int i = 0; i < 3; ++i)
+        {
+            scope.Spawn([&] {
+                Future<> future;
+                promises.push_back(future.GetPromise());
+                await std::move(future);
+                ++finished;
+            });
+        }
+        scope.Spawn([&] { ++finished; });
+        assert(finished == 1);
+        assert(scope.Size() == 3);
+
+        auto joiner = pool.Spawn([&] {
+            await scope.Join();
+            joined = true;
+        });
+        joiner->Resume();
+
+        promises[0].Resolve();
+        promises[2].Resolve();
+        assert(!joined);
+        promises[1].Resolve();
+        assert(joined);
+        assert(finished == 4);
+        assert(scope.IsEmpty());
+    }
+    assert(pool.Size() == 0);
+
+    {
+        // Destroying the scope cancels and recycles all of its Fibers
+        struct Unwind
+        {
+            std::size_t& unwound;
+            ~Unwind() { ++unwound; }
+        };
+
+        std::size_t unwound = 0;
+        {
+            FiberScope scope(pool);
+            for (int i = 0; i < 100; ++i)
+            {
+                scope.Spawn([&] {
+                    Unwind guard{unwound};
+                    ThisFiber()->Suspend();
+                });
+            }
+            assert(pool.Size() == 100);
+            assert(scope.Size() == 100);
+        }
+        assert(unwound == 100);
+        assert(pool.Size() == 0);
+    }
+
+    {
+        // Canceling the scope continues a pending join
+        FiberScope scope(pool);
+        scope.Spawn([] { ThisFiber()->Suspend(); });
+
+        bool joined = false;
+        auto joiner = pool.Spawn([&] {
+            await scope.Join();
+            joined = true;
+        });
+        joiner->Resume();
+        assert(!joined);
+
+        scope.Cancel();
+        assert(joined);
+        assert(scope.IsEmpty());
+    }
+
+    {
+        // A canceled joiner is removed from the scope
+        FiberScope scope(pool);
+        Future<> done;
+        auto done_promise = done.GetPromise();
+        scope.Spawn([&] { await std::move(done); });
+
+        auto joiner = pool.Spawn([&] { await scope.Join(); });
+        joiner->Resume();
+        joiner = nullptr;
+
+        done_promise.Resolve();
+        assert(scope.IsEmpty());
+    }
+}
+
+static void TestSharedFuture()
+{
+    FiberPool pool;
+
+    {
+        // All waiters share the single result by reference
+        SharedFuture<int> phase;
+        auto promise = phase.GetPromise();
+        std::vector<int const*> results;
+
+        std::vector<FiberPtr> fibers;
+        for (int i = 0; i < 3; ++i)
+        {
+            fibers.push_back(pool.Spawn([&] {
+                int const& value = await phase.Wait();
+                results.push_back(&value);
+            }));
+            fibers.back()->Resume();
+        }
+
+        // Waiters which leave early unlink their node
+        fibers[1] = nullptr;
+        assert(results.empty());
+
+        promise.Resolve(2);
+        assert(results.size() == 2);
+        assert(results[0] == results[1]);
+        assert(*results[0] == 2);
+
+        // Awaiting a resolved SharedFuture returns immediately
+        auto late = pool.Spawn([&] {
+            int const& value = await phase.Wait();
+            assert(&value == results[0]);
+            (void)value;
+        });
+        late->Resume();
+        assert(late->Is(Fiber::State::Finished));
+    }
+
+    {
+        // With a Scheduler the waiters are queued in one batch
+        Scheduler scheduler;
+        SharedFuture<int, int> transition;
+        auto promise = transition.GetPromise();
+        int sum = 0;
+
+        std::vector<FiberPtr> fibers;
+        for (int i = 0; i < 3; ++i)
+        {
+            fibers.push_back(pool.Spawn([&] {
+                auto const& result = await transition.Wait();
+                sum += std::get<0>(result) + std::get<1>(result);
+            }));
+            fibers.back()->Resume();
+        }
+
+        promise.Resolve(1, 2);
+        assert(sum == 0);
+        assert(scheduler.Run() == 3);
+        assert(sum == 9);
+    }
+
+    {
+        // A SharedFuture can be created from the Future of Async
+        Future<> resume;
+        auto resume_promise = resume.GetPromise();
+        bool done = false;
+
+        auto fiber = pool.Spawn([&] {
+            SharedFuture<int> shared(Async([&] {
+                await std::move(resume);
+                return 5;
+            }));
+            int const value = await shared.Wait();
+            done = value == 5;
+        });
+        fiber->Resume();
+        resume_promise.Resolve();
+        assert(done);
+    }
+}
+
+static void TestEvent()
+{
+    FiberPool pool;
+
+    {
+        // All waiters are continued on every signal until the Event is reset
+        Event<int> phase;
+        std::vector<int> phases;
+
+        std::vector<FiberPtr> fibers;
+        for (int i = 0; i < 3; ++i)
+        {
+            fibers.push_back(pool.Spawn([&] {
+                for (;;)
+                {
+                    phases.push_back(await phase.Wait());
+                    phase.Reset();
+                }
+            }));
+            fibers.back()->Resume();
+        }
+
+        assert(phase.Signal(1) == 3);
+        assert(phases == std::vector<int>({1, 1, 1}));
+        assert(!phase.IsSet());
+
+        fibers[0] = nullptr;
+        assert(phase.Signal(2) == 2);
+        assert(phases.size() == 5);
+        assert(phases.back() == 2);
+    }
+
+    {
+        // A signaled Event stays ready until it is reset
+        Event<> aggro;
+        aggro.Signal();
+        assert(aggro.IsSet());
+
+        std::size_t count = 0;
+        auto fiber = pool.Spawn([&] {
+            await aggro.Wait();
+            ++count;
+            aggro.Reset();
+            await aggro.Wait();
+            ++count;
+        });
+        fiber->Resume();
+        assert(count == 1);
+        assert(aggro.Signal() == 1);
+        assert(count == 2);
+        assert(fiber->Is(Fiber::State::Finished));
+    }
+
+    {
+        // Waiters which were signaled stay ready when the Event is reset
+        // before they are continued by the Scheduler.
+        Scheduler scheduler;
+        Event<int, int> move;
+        int sum = 0;
+
+        auto fiber = pool.Spawn([&] {
+            auto const position = await move.Wait();
+            sum = std::get<0>(position) + std::get<1>(position);
+        });
+        fiber->Resume();
+
+        assert(move.Signal(3, 4) == 1);
+        move.Reset();
+        assert(scheduler.Run() == 1);
+        assert(sum == 7);
+    }
+
+    {
+        // Waiters receive the values of the signal which continued them,
+        // even when the Event is signaled again before they are resumed.
+        Scheduler scheduler;
+        Event<int> phase;
+        std::vector<int> phases;
+
+        std::vector<FiberPtr> fibers;
+        for (int i = 0; i < 2; ++i)
+        {
+            fibers.push_back(
+                pool.Spawn([&] { phases.push_back(await phase.Wait()); }));
+            fibers.back()->Resume();
+        }
+
+        assert(phase.Signal(1) == 2);
+        assert(phase.Signal(2) == 0);
+        assert(scheduler.Run() == 2);
+        assert(phases == std::vector<int>({1, 1}));
+    }
+
+    {
+        // Continued waiters don't access the Event anymore,
+        // so it may be destroyed before they are resumed.
+        Scheduler scheduler;
+        std::unique_ptr<Event<int>> phase(new Event<int>());
+        int value = 0;
+
+        auto fiber = pool.Spawn([&] { value = await phase->Wait(); });
+        fiber->Resume();
+
+        assert(phase->Signal(3) == 1);
+        phase.reset();
+        assert(scheduler.Run() == 1);
+        assert(value == 3);
+    }
+}
+
+static void TestChannel()
+{
+    FiberPool pool;
+
+    {
+        // Senders are suspended while the buffer is full
+        Channel<int> channel(2);
+        std::size_t sent = 0;
+        auto sender = pool.Spawn([&] {
+            for (int i = 0; i < 5; ++i)
+            {
+                await channel.Send(i);
+                ++sent;
+            }
+        });
+        sender->Resume();
+        assert(sent == 2);
+        assert(channel.IsFull());
+
+        std::vector<int> received;
+        auto receiver = pool.Spawn([&] {
+            for (int i = 0; i < 5; ++i)
+            {
+                received.push_back(await channel.Receive());
+            }
+        });
+        receiver->Resume();
+        assert(sender->Is(Fiber::State::Finished));
+        assert(receiver->Is(Fiber::State::Finished));
+        assert(received == std::vector<int>({0, 1, 2, 3, 4}));
+        assert(channel.IsEmpty());
+    }
+
+    {
+        // Values are handed to waiting receivers directly
+        struct Counted
+        {
+            std::size_t& copies;
+            explicit Counted(std::size_t& copies_) : copies(copies_) {}
+            Counted(Counted const& right) : copies(right.copies)
+            {
+                ++copies;
+            }
+            Counted(Counted&&) = default;
+        };
+
+        Channel<Counted> channel(1);
+        std::size_t copies = 0;
+        std::size_t received = 0;
+        auto receiver = pool.Spawn([&] {
+            for (;;)
+            {
+                Counted value = await channel.Receive();
+                (void)value;
+                ++received;
+            }
+        });
+        receiver->Resume();
+
+        auto sender = pool.Spawn([&] {
+            for (int i = 0; i < 3; ++i)
+            {
+                await channel.Send(Counted(copies));
+            }
+        });
+        sender->Resume();
+        assert(received == 3);
+        assert(channel.IsEmpty());
+        assert(copies == 0);
+    }
+
+    {
+        // A Channel without capacity waits for the receiver on every send
+        Channel<int> channel(0);
+        bool sent = false;
+        auto sender = pool.Spawn([&] {
+            await channel.Send(7);
+            sent = true;
+        });
+        sender->Resume();
+        assert(!sent);
+
+        int value = 0;
+        auto receiver = pool.Spawn([&] { value = await channel.Receive(); });
+        receiver->Resume();
+        assert(value == 7);
+        assert(sent);
+    }
+}
+
+static void TestMailbox()
+{
+    FiberPool pool;
+
+    {
+        Mailbox<int> mailbox(3);
+        assert(mailbox.Capacity() == 4);
+        for (int i = 0; i < 4; ++i)
+        {
+            assert(mailbox.TryPost(i));
+        }
+        assert(!mailbox.TryPost(4));
+        assert(mailbox.Wait(std::chrono::milliseconds(0)));
+
+        // Queued messages are received without waiting
+        int value = -1;
+        auto fiber = pool.Spawn([&] { value = await mailbox.Receive(); });
+        fiber->Resume();
+        assert(value == 0);
+        assert(*mailbox.TryReceive() == 1);
+    }
+
+    {
+        // Messages of foreign threads are passed to the waiting receivers
+        Scheduler scheduler;
+        Mailbox<std::size_t> mailbox(64);
+        constexpr std::size_t producers = 4;
+        constexpr std::size_t messages = 1000;
+
+        std::size_t received = 0;
+        std::size_t sum = 0;
+        std::vector<FiberPtr> receivers;
+        for (int i = 0; i < 2; ++i)
+        {
+            receivers.push_back(pool.Spawn([&] {
+                for (;;)
+                {
+                    sum += await mailbox.Receive();
+                    ++received;
+                }
+            }));
+            receivers.back()->Resume();
+        }
+
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < producers; ++i)
+        {
+            threads.emplace_back([&] {
+                for (std::size_t j = 1; j <= messages; ++j)
+                {
+                    mailbox.Post(j);
+                }
+            });
+        }
+
+        while (received < producers * messages)
+        {
+            mailbox.Wait(std::chrono::milliseconds(10));
+            mailbox.Drain();
+            scheduler.Run();
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        assert(sum == producers * messages * (messages + 1) / 2);
+        assert(!mailbox.TryReceive());
+    }
+}
+
+static void TestSelect()
+{
+    FiberPool pool;
+
+    {
+        // The fiber is continued once with the source which fired first,
+        // the other sources don't take any value.
+        Channel<int> commands(4);
+        Channel<int> messages(4);
+        TimerWheel wheel;
+
+        std::vector<std::size_t> fired;
+        int last = 0;
+        auto fiber = pool.Spawn([&] {
+            for (int i = 0; i < 3; ++i)
+            {
+                auto result = await Select(commands.Receive(),
+                                           messages.Receive(),
+                                           wheel.Wait(TimerWheel::Duration(50)));
+                fired.push_back(result.index);
+                if (result.index == 0)
+                {
+                    last = await std::move(std::get<0>(result.inputs));
+                }
+                else if (result.index == 1)
+                {
+                    last = await std::move(std::get<1>(result.inputs));
+                }
+            }
+        });
+        fiber->Resume();
+        assert(fired.empty());
+
+        auto sender = pool.Spawn([&] {
+            await messages.Send(7);
+            await commands.Send(3);
+        });
+        sender->Resume();
+        assert(fired == std::vector<std::size_t>({1, 0}));
+        assert(last == 3);
+        assert(commands.IsEmpty() && messages.IsEmpty());
+
+        wheel.Advance(TimerWheel::TimePoint(100));
+        assert(fired == std::vector<std::size_t>({1, 0, 2}));
+        assert(fiber->Is(Fiber::State::Finished));
+    }
+
+    {
+        // A ready source wins without suspending and the others stay queued
+        Channel<int> first(1);
+        Channel<int> second(1);
+        std::size_t index = 0;
+        auto fiber = pool.Spawn([&] {
+            await first.Send(1);
+            await second.Send(2);
+            index = (await Select(second.Receive(), first.Receive())).index;
+        });
+        fiber->Resume();
+        assert(index == 0);
+        assert(second.IsEmpty());
+        assert(first.Size() == 1);
+    }
+
+    {
+        // Inputs which complete on registration continue the other
+        // combinators without suspending.
+        Channel<int> loot(2);
+        Future<int> reward;
+        auto promise = reward.GetPromise();
+
+        int sum = 0;
+        auto fiber = pool.Spawn([&] {
+            await loot.Send(4);
+            await loot.Send(5);
+
+            auto any = await WhenAny(loot.Receive(), std::move(reward));
+            assert(any.index == 0);
+            sum += await std::move(std::get<0>(any.inputs));
+
+            auto all = await WhenAll(loot.Receive(), MakeReadyFuture(1));
+            sum += std::get<0>(all) + std::get<1>(all);
+        });
+        fiber->Resume();
+        assert(fiber->Is(Fiber::State::Finished));
+        assert(sum == 10);
+        assert(loot.IsEmpty());
+        assert(promise.IsCanceled());
+    }
+}
+
+static void TestFiberSync()
+{
+    FiberPool pool;
+
+    {
+        // The mutex is handed to its waiters in FIFO order
+        Scheduler scheduler;
+        FiberMutex mutex;
+        std::vector<int> order;
+
+        mutex.Lock();
+        std::vector<FiberPtr> fibers;
+        for (int i = 0; i < 3; ++i)
+        {
+            fibers.push_back(pool.Spawn([&, i] {
+                std::lock_guard<FiberMutex> guard(mutex);
+                order.push_back(i);
+            }));
+            fibers.back()->Resume();
+        }
+        assert(order.empty());
+
+        mutex.Unlock();
+        assert(mutex.IsLocked());
+        assert(!mutex.TryLock());
+        assert(scheduler.Run() == 3);
+        assert(order == std::vector<int>({0, 1, 2}));
+        assert(!mutex.IsLocked());
+    }
+
+    {
+        // A waiter which is canceled after it was granted the mutex
+        // passes the mutex on to the next waiter.
+        Scheduler scheduler;
+        FiberMutex mutex;
+        bool locked = false;
+
+        mutex.Lock();
+        auto canceled = pool.Spawn([&] {
+            mutex.Lock();
+            mutex.Unlock();
+        });
+        auto next = pool.Spawn([&] {
+            mutex.Lock();
+            locked = true;
+            mutex.Unlock();
+        });
+        canceled->Resume();
+        next->Resume();
+
+        mutex.Unlock();
+        canceled = nullptr;
+        scheduler.Run();
+        assert(locked);
+        assert(!mutex.IsLocked());
+    }
+
+    {
+        // The semaphore limits the count of concurrent Fibers
+        Scheduler scheduler;
+        FiberSemaphore semaphore(2);
+        Event<> gate;
+        std::size_t active = 0;
+        std::size_t peak = 0;
+        std::size_t finished = 0;
+
+        std::vector<FiberPtr> fibers;
+        for (int i = 0; i < 5; ++i)
+        {
+            fibers.push_back(pool.Spawn([&] {
+                semaphore.Acquire();
+                peak = std::max(peak, ++active);
+                await gate.Wait();
+                --active;
+                ++finished;
+                semaphore.Release();
+            }));
+            fibers.back()->Resume();
+        }
+        assert(active == 2);
+        assert(semaphore.Count() == 0);
+        assert(!semaphore.TryAcquire());
+
+        gate.Signal();
+        scheduler.Run();
+        assert(finished == 5);
+        assert(peak == 2);
+        assert(semaphore.Count() == 2);
+    }
+
+    {
+        // A consumer waits on the condition variable until
+        // the producer published a value.
+        FiberMutex mutex;
+        FiberConditionVariable available;
+        std::vector<int> queue;
+        std::vector<int> consumed;
+
+        auto consumer = pool.Spawn([&] {
+            std::unique_lock<FiberMutex> lock(mutex);
+            for (;;)
+            {
+                available.Wait(lock, [&] { return !queue.empty(); });
+                int const value = queue.front();
+                queue.erase(queue.begin());
+                if (value < 0)
+                {
+                    return;
+                }
+                consumed.push_back(value);
+            }
+        });
+        consumer->Resume();
+        assert(!mutex.IsLocked());
+
+        for (int value : {1, 2, -1})
+        {
+            {
+                std::lock_guard<FiberMutex> guard(mutex);
+                queue.push_back(value);
+            }
+            available.NotifyOne();
+        }
+        assert(consumer->Is(Fiber::State::Finished));
+        assert(consumed == std::vector<int>({1, 2}));
+        assert(!mutex.IsLocked());
+    }
+}
+
+static void TestRemoteFuture()
+{
+    FiberPool pool;
+
+    {
+        // The waiting Fiber is continued on its own thread
+        Scheduler scheduler;
+        RemoteFuture<int> future;
+        auto promise = future.GetPromise();
+
+        std::thread::id resumed_on;
+        int result = 0;
+        auto fiber = pool.Spawn([&] {
+            result = await std::move(future);
+            resumed_on = std::this_thread::get_id();
+        });
+        fiber->Resume();
+
+        std::thread worker([&] { promise.Resolve(42); });
+        worker.join();
+        assert(result == 0);
+        assert(!scheduler.IsEmpty());
+
+        assert(scheduler.Run() == 1);
+        assert(result == 42);
+        assert(resumed_on == std::this_thread::get_id());
+    }
+
+    {
+        // A result which was resolved before it is awaited is ready
+        RemoteFuture<int, std::string> future;
+        std::thread worker(
+            [promise = future.GetPromise()]() mutable {
+                promise.Resolve(1, "Hogger");
+            });
+        worker.join();
+        assert(future.IsReady());
+
+        std::string name;
+        auto fiber = pool.Spawn([&] {
+            name = std::get<1>(await std::move(future));
+        });
+        fiber->Resume();
+        assert(name == "Hogger");
+    }
+
+    {
+        // The promise observes that the future was dropped
+        RemoteFuture<> future;
+        auto promise = future.GetPromise();
+        assert(!promise.IsCanceled());
+        future = RemoteFuture<>();
+        assert(promise.IsCanceled());
+    }
+
+    {
+        // Many workers resolve futures which are awaited by Fibers
+        Scheduler scheduler;
+        constexpr std::size_t count = 256;
+        std::vector<RemoteFuture<std::size_t>> futures(count);
+        std::vector<RemotePromise<std::size_t>> promises;
+        for (auto& future : futures)
+        {
+            promises.push_back(future.GetPromise());
+        }
+
+        std::size_t sum = 0;
+        std::vector<FiberPtr> fibers;
+        for (auto& future : futures)
+        {
+            fibers.push_back(pool.Spawn([&] { sum += await std::move(future); }));
+            fibers.back()->Resume();
+        }
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            workers.emplace_back([&, i] {
+                for (std::size_t j = i; j < count; j += 4)
+                {
+                    promises[j].Resolve(j);
+                }
+            });
+        }
+
+        std::size_t resumed = 0;
+        while (resumed < count)
+        {
+            resumed += scheduler.Run();
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        assert(sum == (count * (count - 1)) / 2);
+    }
 }
 
 void TestPointer()
@@ -151,9 +1317,478 @@ void TestPointer()
     assert(ptr);
 }
 
+static void TestStackClasses()
+{
+    assert(FiberPool::ClassOf(1) == StackClass::Small);
+    assert(FiberPool::ClassOf(FiberPool::SizeOf(StackClass::Medium)) ==
+           StackClass::Medium);
+    assert(FiberPool::ClassOf(1024 * 60) == StackClass::Large);
+
+    FiberPool pool;
+    {
+        // Small stacks still support canceling suspended Fibers
+        auto fiber = pool.Spawn(StackClass::Small, [] {
+            ThisFiber()->Suspend();
+            assert(false && "Unreachable");
+        });
+        fiber->Resume();
+        fiber->Cancel();
+        assert(fiber->Is(Fiber::State::Canceled));
+    }
+
+    {
+        bool done = false;
+        auto fiber = pool.Spawn(1024 * 48, [&] {
+            volatile char buffer[1024 * 40];
+            buffer[0] = 1;
+            done = buffer[0] == 1;
+        });
+        fiber->Resume();
+        assert(done);
+    }
+
+    {
+        // A literal zero is a stack hint and never taken for a tag
+        auto fiber = pool.Spawn(0, [] {});
+        assert(fiber->GetStackClass() == StackClass::Small);
+        fiber->Resume();
+    }
+
+    {
+        // Every class is recycled separately
+        std::vector<FiberPtr> fibers;
+        for (int i = 0; i < 12; ++i)
+        {
+            fibers.push_back(
+                pool.Spawn(static_cast<StackClass>(i % 3), [] {}));
+        }
+        for (auto& fiber : fibers)
+        {
+            fiber->Resume();
+            assert(fiber->Is(Fiber::State::Finished));
+        }
+    }
+}
+
+static void TestStackProfiling()
+{
+    FiberPool pool;
+    pool.SetStackTuning(true);
+
+    char const* const deep = TC_SPAWN_SITE;
+    char const* const shallow = "shallow";
+    for (int i = 0; i < 32; ++i)
+    {
+        pool.SpawnTagged(deep, [] {
+                volatile char buffer[1024 * 10];
+                buffer[0] = 1;
+                buffer[sizeof(buffer) - 1] = buffer[0];
+            })
+            ->Resume();
+        pool.SpawnTagged(shallow, [] {})->Resume();
+    }
+
+    auto const report = pool.StackReport();
+    assert(report.size() == 2);
+    assert(report[0].tag == deep);
+    assert(report[0].samples == 32);
+    assert(report[0].max >= 1024 * 10);
+    assert(report[0].Percentile(0.5) <= report[0].max);
+    assert(report[1].tag == shallow);
+    assert(report[1].Mean() < report[0].Mean());
+
+    // The tuned stacks are chosen from the measured usage
+    bool done = false;
+    auto fiber = pool.SpawnTagged(deep, [&] { done = true; });
+    assert(fiber->GetStackClass() == StackClass::Large);
+    fiber->Resume();
+    assert(done);
+    assert(pool.SpawnTagged(shallow, [] {})->GetStackClass() == StackClass::Small);
+}
+
+static void TestFiberLimits()
+{
+    FiberPool pool;
+    pool.Reserve(16);
+    pool.Reserve(4, StackClass::Large);
+    assert(pool.Size() == 0);
+    assert(!pool.IsExhausted());
+
+    pool.SetMaxFibers(2);
+    auto first = pool.Spawn([] { ThisFiber()->Suspend(); });
+    auto second = pool.TrySpawn([] {});
+    assert(second);
+    assert(pool.IsExhausted());
+    assert(pool.Pressure() == 1.);
+    assert(!pool.TrySpawn([] {}));
+
+    // Finished Fibers give room for new ones
+    second->Resume();
+    second = nullptr;
+    assert(pool.Size() == 1);
+    assert(pool.TrySpawn(StackClass::Small, [] {}));
+
+    pool.SetMaxFibers(0);
+    assert(pool.Pressure() == 0.);
+    first->Cancel();
+}
+
+static void TestFiberReturn()
+{
+    FiberPool pool;
+    {
+        std::vector<FiberPtr> fibers;
+        fibers.push_back(pool.Spawn([] { ThisFiber()->Suspend(); }));
+        fibers.push_back(pool.Spawn([] {}));
+        fibers[0]->Resume();
+        fibers[1]->Resume();
+
+        WeakFiberPtr weak(fibers[0].Get());
+
+        // Release the last strong references on another thread
+        std::thread([fibers = std::move(fibers)]() mutable {
+            fibers.clear();
+        }).join();
+
+        assert(pool.Size() == 2);
+        assert(weak->Is(Fiber::State::Running));
+        assert(pool.Reclaim() == 2);
+        assert(weak->Is(Fiber::State::Canceled));
+        assert(pool.Size() == 1);
+
+        // Also the weak references may be released on other threads
+        std::thread([weak = std::move(weak)]() mutable { weak = nullptr; })
+            .join();
+        assert(pool.Size() == 1);
+    }
+
+    // Returned Fibers are recycled before new ones are allocated
+    pool.Spawn([] {})->Resume();
+    assert(pool.Size() == 0);
+}
+
+static void TestScheduler()
+{
+    FiberPool pool;
+    Scheduler scheduler;
+    assert(Scheduler::Current() == &scheduler);
+
+    Future<int> first;
+    Future<int> second;
+    auto waiting = pool.Spawn([&] {
+        int const value = await std::move(second);
+        assert(value == 8);
+        (void)value;
+    });
+    auto resolving = pool.Spawn([&] {
+        int const value = await std::move(first);
+        second.GetPromise().Resolve(value + 1);
+    });
+
+    waiting->Resume();
+    resolving->Resume();
+
+    // Resolving a Future only queues the waiting Fiber
+    first.GetPromise().Resolve(7);
+    assert(resolving->Is(Fiber::State::Running));
+
+    // Fibers which become ready while draining are continued in the same pass
+    assert(scheduler.Run() == 2);
+    assert(resolving->Is(Fiber::State::Finished));
+    assert(waiting->Is(Fiber::State::Finished));
+    assert(scheduler.IsEmpty());
+}
+
+static void TestTaskQueue()
+{
+    FiberPool pool;
+    {
+        TaskQueue queue(pool, 1);
+        int counter = 0;
+        for (int i = 0; i < 1000; ++i)
+        {
+            queue.Post([&] {
+                ++counter;
+                if (counter == 1)
+                {
+                    // Tasks posted from a task are run by the same worker
+                    queue.Post([&] { counter += 1000; });
+                }
+            });
+        }
+        assert(queue.Run() == 1001);
+        assert(counter == 2000);
+        assert(queue.Workers() == 1);
+
+        // Suspending tasks detach from the other tasks
+        Future<> future;
+        auto promise = future.GetPromise();
+        queue.Post([&] { await std::move(future); });
+        queue.Post([&] { ++counter; });
+        assert(queue.Run() == 1);
+        assert(counter == 2001);
+        assert(queue.Workers() == 2);
+
+        // The worker of a finished task only stays when it is needed
+        promise.Resolve();
+        assert(queue.Run() == 1);
+        queue.Post([&] { ++counter; });
+        assert(queue.Run() == 1);
+        assert(counter == 2002);
+    }
+
+    {
+        // Small tasks are stored inline and large ones on the heap,
+        // both release their captures after running or when dropped.
+        auto token = std::make_shared<int>(0);
+        std::size_t large_sum = 0;
+        {
+            TaskQueue queue(pool);
+            std::array<std::size_t, 16> large{};
+            large.back() = 1;
+            for (int i = 0; i < 64; ++i)
+            {
+                queue.Post([token] { ++*token; });
+                queue.Post([token, large, &large_sum] {
+                    large_sum += large.back();
+                });
+            }
+            assert(token.use_count() == 129);
+            assert(queue.Run() == 128);
+            assert(*token == 64 && large_sum == 64);
+            assert(token.use_count() == 1);
+
+            queue.Post([token] { ++*token; });
+            queue.Post([token, large] { (void)large; });
+            assert(token.use_count() == 3);
+        }
+        assert(token.use_count() == 1);
+        assert(*token == 64);
+    }
+    assert(pool.Size() == 0);
+}
+
+static void TestTimerWheel()
+{
+    {
+        TimerWheel wheel(TimerWheel::TimePoint(5));
+        std::minstd_rand generator(1);
+        std::vector<std::int64_t> deadlines;
+        std::vector<Future<>> futures;
+        for (int i = 0; i < 2000; ++i)
+        {
+            // Spread the deadlines over all levels including the overflow
+            std::int64_t const deadline =
+                6 + (std::int64_t(generator()) >> (i % 31)) +
+                ((i % 97 == 0) ? (std::int64_t(1) << 40) : 0);
+            deadlines.push_back(deadline);
+            futures.push_back(
+                wheel.WaitUntil(TimerWheel::TimePoint(deadline)));
+        }
+        assert(wheel.Size() == futures.size());
+
+        std::int64_t now = 5;
+        while (wheel.Size() > 0)
+        {
+            now += std::int64_t(generator()) % ((now / 8) + 100);
+            wheel.Advance(TimerWheel::TimePoint(now));
+
+            for (std::size_t i = 0; i < futures.size(); ++i)
+            {
+                assert(futures[i].IsReady() == (deadlines[i] <= now));
+            }
+        }
+    }
+
+    {
+        TimerWheel wheel;
+        TimerId id;
+        {
+            // Timers are canceled after their Future was dropped
+            Future<> dropped;
+            id = wheel.Schedule(TimerWheel::TimePoint(20),
+                                dropped.GetPromise());
+        }
+        Future<> remaining = wheel.Wait(30ms);
+        assert(wheel.Size() == 2);
+
+        assert(wheel.Cancel(id));
+        assert(!wheel.Cancel(id));
+        assert(wheel.Size() == 1);
+
+        assert(wheel.Advance(TimerWheel::TimePoint(30)) == 1);
+        assert(remaining.IsReady());
+    }
+
+    {
+        struct WaitingAI : AsyncCreatureAI
+        {
+            bool done = false;
+
+            using AsyncCreatureAI::AsyncCreatureAI;
+
+            void Reset() override
+            {
+                await Wait(100ms);
+                await Wait(50ms, 60ms);
+                done = true;
+            }
+        };
+
+        FiberPool pool;
+        TimerWheel wheel;
+        WaitingAI ai(wheel);
+        auto fiber = pool.Spawn([&] { ai.Reset(); });
+        fiber->Resume();
+
+        wheel.Advance(TimerWheel::TimePoint(99));
+        assert(!ai.done);
+        wheel.Advance(TimerWheel::TimePoint(149));
+        assert(!ai.done);
+        wheel.Advance(TimerWheel::TimePoint(160));
+        assert(ai.done);
+    }
+}
+
+static void TestWorkerPool()
+{
+    std::atomic<int> counter{0};
+    {
+        WorkerPool workers(4);
+        for (int i = 0; i < 1000; ++i)
+        {
+            workers.Post([&] {
+                int const value = await Async([] { return 1; });
+
+                // Jobs posted from a worker are queued locally
+                workers.Post([&counter, value] { counter += value; });
+            });
+        }
+    }
+    assert(counter == 1000);
+
+    {
+        // Suspended Fibers are canceled when the WorkerPool is destroyed
+        WorkerPool workers(2);
+        workers.Post([] { ThisFiber()->Suspend(); });
+    }
+
+    counter = 0;
+    {
+        // Workers with an exhausted FiberPool leave jobs to other workers
+        WorkerPool workers(2, 1);
+        workers.Post([] { ThisFiber()->Suspend(); });
+        for (int i = 0; i < 100; ++i)
+        {
+            workers.Post([&] { ++counter; });
+        }
+    }
+    assert(counter == 100);
+
+    counter = 0;
+    {
+        // Jobs posted to another pool from a worker are queued on that pool
+        WorkerPool other(1);
+        {
+            WorkerPool workers(1);
+            workers.Post([&] { other.Post([&] { ++counter; }); });
+        }
+    }
+    assert(counter == 1);
+
+    {
+        // A RemoteFuture which is resolved from another thread wakes up
+        // the sleeping worker which awaits it.
+        std::unique_ptr<RemotePromise<int>> promise;
+        std::atomic<bool> posted{false};
+        std::atomic<int> result{0};
+
+        WorkerPool workers(1);
+        workers.Post([&] {
+            RemoteFuture<int> future;
+            promise =
+                std::make_unique<RemotePromise<int>>(future.GetPromise());
+            posted = true;
+            result = await std::move(future);
+        });
+
+        while (!posted)
+        {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::thread resolver([&] { promise->Resolve(7); });
+        resolver.join();
+
+        auto const deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (result == 0 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        assert(result == 7);
+    }
+
+    {
+        // An exhausted worker continues once its suspended Fiber
+        // is woken up from another thread and finishes.
+        std::unique_ptr<RemotePromise<>> promise;
+        std::atomic<bool> posted{false};
+        std::atomic<bool> started{false};
+
+        WorkerPool workers(1, 1);
+        workers.Post([&] {
+            RemoteFuture<> future;
+            promise = std::make_unique<RemotePromise<>>(future.GetPromise());
+            posted = true;
+            await std::move(future);
+        });
+
+        while (!posted)
+        {
+            std::this_thread::yield();
+        }
+        workers.Post([&] { started = true; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        assert(!started);
+
+        std::thread resolver([&] { promise->Resolve(); });
+        resolver.join();
+
+        auto const deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (!started && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        assert(started);
+    }
+}
+
 int main(int, char**)
 {
     TestResumeDestroy();
     TestAsync();
+    TestThen();
+    TestWhenAll();
+    TestWhenAny();
+    TestCancellation();
+    TestFiberScope();
+    TestSharedFuture();
+    TestEvent();
+    TestChannel();
+    TestMailbox();
+    TestSelect();
+    TestFiberSync();
+    TestRemoteFuture();
     TestPointer();
+    TestStackClasses();
+    TestStackProfiling();
+    TestFiberLimits();
+    TestFiberReturn();
+    TestScheduler();
+    TestTaskQueue();
+    TestTimerWheel();
+    TestWorkerPool();
 }
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2008-2018 TrinityCore <https://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <cstdint>
+#include "Await.h"
+#include "Channel.h"
+#include "FiberPool.h"
+#include "Future.h"
+#include "Scheduler.h"
+#include "Select.h"
+#include "Task.h"
+#include "TimerWheel.h"
+#include "WhenAll.h"
+#include "WhenAny.h"
+
+using namespace Trinity;
+
+#ifdef TC_FIBER_HAS_COROUTINES
+static Task<int> Immediate(int value)
+{
+    co_return value;
+}
+
+static Task<int> Add(Future<int> left, Future<int> right)
+{
+    int const first = co_await std::move(left);
+    int const second = co_await std::move(right);
+    co_return first + second;
+}
+
+static Task<int> Chain(Future<int> left, Future<int> right)
+{
+    int const sum = co_await Add(std::move(left), std::move(right));
+    co_return sum + co_await Immediate(1);
+}
+
+static Task<> Sleep(TimerWheel& wheel, bool& done)
+{
+    co_await wheel.Wait(TimerWheel::Duration(10));
+    done = true;
+}
+
+static Task<int> Sum(Future<int> left, Future<int> right)
+{
+    auto values = co_await WhenAll(std::move(left), std::move(right));
+    co_return std::get<0>(values) + std::get<1>(values);
+}
+
+static Task<int> Consume(Future<int>& future)
+{
+    co_return co_await std::move(future);
+}
+
+static Task<int> Forward(Task<int>& task)
+{
+    co_return co_await std::move(task);
+}
+
+static void TestTask()
+{
+    {
+        Task<int> task = Immediate(3);
+        assert(task.IsReady());
+    }
+
+    {
+        // Tasks are continued from the resolver of the awaited Future
+        Future<int> left;
+        Future<int> right;
+        auto left_promise = left.GetPromise();
+        auto right_promise = right.GetPromise();
+
+        Task<int> task = Chain(std::move(left), std::move(right));
+        assert(!task.IsReady());
+        left_promise.Resolve(2);
+        assert(!task.IsReady());
+        right_promise.Resolve(4);
+        assert(task.IsReady());
+    }
+
+    {
+        Future<int> left;
+        auto promise = left.GetPromise();
+        Task<int> task = Sum(std::move(left), MakeReadyFuture(2));
+        assert(!task.IsReady());
+        promise.Resolve(1);
+        assert(task.IsReady());
+    }
+
+    {
+        TimerWheel wheel;
+        bool done = false;
+        Task<> task = Sleep(wheel, done);
+        assert(!done);
+        wheel.Advance(TimerWheel::TimePoint(10));
+        assert(done && task.IsReady());
+    }
+
+    {
+        // Destroying a suspended Task drops the Futures it waits for
+        Future<int> left;
+        auto promise = left.GetPromise();
+        {
+            Task<int> task = Add(std::move(left), MakeReadyFuture(1));
+        }
+        promise.Resolve(1);
+    }
+
+    {
+        // Destroying a suspended Task removes its continuation from
+        // the awaitables which outlive it
+        Future<int> value;
+        auto promise = value.GetPromise();
+        {
+            Task<int> task = Consume(value);
+            assert(!task.IsReady());
+        }
+        promise.Resolve(3);
+        assert(value.IsReady());
+    }
+
+    {
+        // The same applies to awaited Tasks
+        Future<int> value;
+        auto promise = value.GetPromise();
+        Task<int> inner = Consume(value);
+        {
+            Task<int> outer = Forward(inner);
+            assert(!outer.IsReady());
+        }
+        promise.Resolve(4);
+        assert(inner.IsReady());
+    }
+
+    {
+        // While the thread has a Scheduler, Tasks are queued on it instead
+        // of being continued on the stack of the resolver
+        Scheduler scheduler;
+        Future<int> value;
+        auto promise = value.GetPromise();
+        Task<int> task = Consume(value);
+        promise.Resolve(3);
+        assert(!task.IsReady());
+        assert(scheduler.Run() == 1);
+        assert(task.IsReady());
+
+        // A queued Task which is destroyed is removed from the Scheduler
+        Future<int> other;
+        auto other_promise = other.GetPromise();
+        {
+            Task<int> dropped = Consume(other);
+            other_promise.Resolve(4);
+            assert(!scheduler.IsEmpty());
+        }
+        assert(scheduler.IsEmpty());
+        assert(scheduler.Run() == 0);
+    }
+}
+
+static Task<int> Gather(Channel<int>& left, Channel<int>& right)
+{
+    int sum = co_await left.Receive();
+    auto values = co_await WhenAll(left.Receive(), right.Receive());
+    sum += std::get<0>(values) + std::get<1>(values);
+    auto any = co_await WhenAny(right.Receive(), left.Receive());
+    sum += co_await std::move(std::get<0>(any.inputs));
+    auto selected = co_await Select(left.Receive(), right.Receive());
+    co_return sum + selected.index;
+}
+
+static void TestTaskChannels()
+{
+    FiberPool pool;
+
+    // Channel operations which complete on registration continue the
+    // Task directly, also when they are combined.
+    Channel<int> left(4);
+    Channel<int> right(4);
+    auto fiber = pool.Spawn([&] {
+        await left.Send(1);
+        await left.Send(2);
+        await right.Send(3);
+        await right.Send(4);
+        await right.Send(5);
+    });
+    fiber->Resume();
+
+    Task<int> task = Gather(left, right);
+    assert(task.IsReady());
+    assert(fiber->Is(Fiber::State::Finished));
+
+    int result = 0;
+    auto waiter = pool.Spawn([&] { result = await std::move(task); });
+    waiter->Resume();
+    assert(result == 1 + 2 + 3 + 4 + 1);
+    assert(left.IsEmpty() && right.IsEmpty());
+}
+
+static void TestTaskFromFiber()
+{
+    FiberPool pool;
+    Scheduler scheduler;
+
+    Future<int> left;
+    auto promise = left.GetPromise();
+
+    int result = 0;
+    auto fiber = pool.Spawn([&] {
+        result = await Chain(std::move(left), MakeReadyFuture(5));
+    });
+    fiber->Resume();
+    assert(result == 0);
+
+    // The Task and the waiting Fiber are continued through the Scheduler
+    promise.Resolve(3);
+    assert(result == 0);
+    assert(scheduler.Run() == 2);
+    assert(result == 9);
+    assert(fiber->Is(Fiber::State::Finished));
+
+    {
+        // A Task which outlives its canceled waiter doesn't continue it
+        Future<int> value;
+        auto resolver = value.GetPromise();
+        Task<int> task = Add(std::move(value), MakeReadyFuture(1));
+
+        auto waiter = pool.Spawn([&] { result = await std::move(task); });
+        waiter->Resume();
+        waiter = nullptr;
+
+        resolver.Resolve(2);
+        assert(scheduler.Run() == 1);
+        assert(task.IsReady());
+        assert(scheduler.IsEmpty());
+        assert(result == 9);
+    }
+}
+#endif
+
+int main(int, char**)
+{
+#ifdef TC_FIBER_HAS_COROUTINES
+    TestTask();
+    TestTaskFromFiber();
+    TestTaskChannels();
+#endif
+    return 0;
+}